@@ -0,0 +1,279 @@
+// Post-transform vertex cache statistics for OFF models, before and after
+// the load-time reordering Mesh applies (optimizeVertexCache followed by
+// optimizeVertexFetch), and the size, fetch traffic and precision of the
+// float and compact GPU vertex layouts, and the levels of detail built by
+// MeshSimplifier, and the clusters Mesh culls per frame.
+//
+// Usage: mesh_cache_bench [model.off ...]   (default: the bundled models)
+
+#include "OFFReader.h"
+#include "mesh_clusters.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "offset_allocator.h"
+#include "vertex_packing.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Index buffer in OFF face order, with the same fan triangulation as Mesh
+static std::vector<unsigned int> triangulate(const OffModel* model) {
+    std::vector<unsigned int> indices;
+    for (int i = 0; i < model->numberOfPolygons; i++) {
+        for (int j = 0; j < model->polygons[i].noSides - 2; j++) {
+            indices.push_back(model->polygons[i].v[0]);
+            indices.push_back(model->polygons[i].v[j + 1]);
+            indices.push_back(model->polygons[i].v[j + 2]);
+        }
+    }
+    return indices;
+}
+
+// Float layout of Mesh's GPU buffer (MeshVertex: three vec3)
+const size_t FLOAT_VERTEX_SIZE = 36;
+
+// Levels of detail Mesh builds (MESH_LOD_COUNT in mesh.h, which needs GL)
+const int LOD_COUNT = 5;
+
+// Vertex fetch overfetch: bytes read from memory, in 64-byte lines through
+// a small FIFO line cache, per byte of vertex data. Only post-transform
+// cache misses fetch. 1 means every line is read exactly once.
+static float vertexOverfetch(const std::vector<unsigned int>& indices, size_t vertexCount,
+                             size_t vertexSize = FLOAT_VERTEX_SIZE) {
+    const size_t lineSize = 64;
+    const long long lineCacheSize = 64;
+    std::vector<long long> vertexMiss(vertexCount, -1);
+    std::vector<long long> lineMiss((vertexCount * vertexSize + lineSize - 1) / lineSize, -1);
+    long long vertexMisses = 0, lineMisses = 0;
+    for (unsigned int v : indices) {
+        if (vertexMiss[v] >= 0 && vertexMisses - vertexMiss[v] < VERTEX_CACHE_ANALYZE_SIZE) continue;
+        vertexMiss[v] = vertexMisses++;
+        for (size_t line = v * vertexSize / lineSize; line <= (v * vertexSize + vertexSize - 1) / lineSize; line++) {
+            if (lineMiss[line] < 0 || lineMisses - lineMiss[line] >= lineCacheSize) {
+                lineMiss[line] = lineMisses++;
+            }
+        }
+    }
+    return static_cast<float>(lineMisses * lineSize) / static_cast<float>(vertexCount * vertexSize);
+}
+
+// Positions normalized to a 2x2x2 box as Mesh does, in reordered vertex order
+static std::vector<glm::vec3> normalizedPositions(const OffModel* model, const std::vector<unsigned int>& remap) {
+    glm::vec3 lo(model->vertices[0].x, model->vertices[0].y, model->vertices[0].z), hi = lo;
+    std::vector<glm::vec3> positions(model->numberOfVertices);
+    for (int i = 0; i < model->numberOfVertices; i++) {
+        positions[i] = glm::vec3(model->vertices[i].x, model->vertices[i].y, model->vertices[i].z);
+        lo = glm::min(lo, positions[i]);
+        hi = glm::max(hi, positions[i]);
+    }
+    glm::vec3 size = hi - lo;
+    float scaleFactor = 2.0f / std::max(std::max(size.x, size.y), size.z);
+    for (glm::vec3& p : positions) {
+        p = (p - (lo + hi) * 0.5f) * scaleFactor;
+    }
+    remapVertices(positions, remap);
+    return positions;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+    if (paths.empty()) {
+        paths = { "models/1grm.off", "models/2oar.off", "models/3sy7.off", "models/4hhb.off" };
+    }
+
+    std::printf("%-18s %9s %9s | %7s %7s %9s | %7s %7s %9s | %8s\n", "model", "vertices", "triangles",
+                "ACMR", "ATVR", "overfetch", "ACMR", "ATVR", "overfetch", "ms");
+    std::printf("%-18s %9s %9s | %-25s | %-25s |\n", "", "", "", "before", "after");
+
+    // Models are kept, with their reordered indices, for the layout table
+    struct LoadedModel {
+        std::string name;
+        OffModel* model;
+        std::vector<unsigned int> indices;
+        std::vector<unsigned int> remap;    // OFF vertex order to reordered
+    };
+    std::vector<LoadedModel> results;
+
+    int failures = 0;
+    for (const std::string& path : paths) {
+        OffModel* model = readOffFile(const_cast<char*>(path.c_str()));
+        if (!model) {
+            failures++;
+            continue;
+        }
+
+        std::vector<unsigned int> indices = triangulate(model);
+        size_t vertexCount = static_cast<size_t>(model->numberOfVertices);
+        VertexCacheStats before = analyzeVertexCache(indices, vertexCount);
+        float overfetchBefore = vertexOverfetch(indices, vertexCount);
+
+        auto start = std::chrono::steady_clock::now();
+        optimizeVertexCache(indices, vertexCount);
+        std::vector<unsigned int> remap = optimizeVertexFetch(indices, vertexCount);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        VertexCacheStats after = analyzeVertexCache(indices, vertexCount);
+        float overfetchAfter = vertexOverfetch(indices, vertexCount);
+
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        std::printf("%-18s %9d %9zu | %7.3f %7.3f %9.2f | %7.3f %7.3f %9.2f | %8.1f\n",
+                    name.c_str(), model->numberOfVertices, indices.size() / 3,
+                    before.acmr, before.atvr, overfetchBefore,
+                    after.acmr, after.atvr, overfetchAfter, ms);
+        results.push_back({name, model, indices, remap});
+    }
+
+    // Vertex layouts of the reordered meshes. Positions are normalized to
+    // a 2x2x2 box first, as Mesh does; errors are relative to that box.
+    std::printf("\n%-18s | %10s %10s | %12s %14s | %11s %10s\n", "model", "float MB", "compact MB",
+                "float MB/frm", "compact MB/frm", "max pos err", "max nrm deg");
+    for (LoadedModel& loaded : results) {
+        OffModel* model = loaded.model;
+        computeNormals(model);
+        struct Vertex { glm::vec3 position, normal; };
+        std::vector<Vertex> vertices(model->numberOfVertices);
+        glm::vec3 lo(model->vertices[0].x, model->vertices[0].y, model->vertices[0].z), hi = lo;
+        for (int i = 0; i < model->numberOfVertices; i++) {
+            vertices[i].position = glm::vec3(model->vertices[i].x, model->vertices[i].y, model->vertices[i].z);
+            vertices[i].normal = glm::vec3(model->vertices[i].normal.x, model->vertices[i].normal.y, model->vertices[i].normal.z);
+            lo = glm::min(lo, vertices[i].position);
+            hi = glm::max(hi, vertices[i].position);
+        }
+        glm::vec3 size = hi - lo;
+        float scaleFactor = 2.0f / std::max(std::max(size.x, size.y), size.z);
+        for (Vertex& v : vertices) {
+            v.position = (v.position - (lo + hi) * 0.5f) * scaleFactor;
+        }
+
+        PositionQuantization q = VertexPacking::computePositionQuantization(vertices.begin(), vertices.end());
+        float maxPositionError = 0.0f, maxNormalDegrees = 0.0f;
+        for (const Vertex& v : vertices) {
+            PackedMeshVertex packed = VertexPacking::packVertex(v.position, v.normal, glm::vec3(0.8f), q);
+            glm::vec3 p = VertexPacking::unpackPosition(packed, q);
+            maxPositionError = std::max(maxPositionError, glm::length(p - v.position));
+            float length = glm::length(v.normal);
+            if (length > 0.0f) {
+                float c = glm::dot(VertexPacking::unpackNormal(packed), v.normal / length);
+                maxNormalDegrees = std::max(maxNormalDegrees, std::acos(std::min(c, 1.0f)) * 57.29578f);
+            }
+        }
+
+        size_t vertexCount = vertices.size();
+        double mb = 1024.0 * 1024.0;
+        double floatFetch = vertexOverfetch(loaded.indices, vertexCount, FLOAT_VERTEX_SIZE) * vertexCount * FLOAT_VERTEX_SIZE;
+        double packedFetch = vertexOverfetch(loaded.indices, vertexCount, sizeof(PackedMeshVertex)) * vertexCount * sizeof(PackedMeshVertex);
+        std::printf("%-18s | %10.2f %10.2f | %12.2f %14.2f | %11.2e %10.3f\n", loaded.name.c_str(),
+                    vertexCount * FLOAT_VERTEX_SIZE / mb, vertexCount * sizeof(PackedMeshVertex) / mb,
+                    floatFetch / mb, packedFetch / mb, maxPositionError, maxNormalDegrees);
+    }
+    
+    // Levels of detail as Mesh builds them: each halves the triangles of
+    // the previous one. Errors are in the same normalized units.
+    std::printf("\n%-18s | %-60s | %8s\n", "model", "triangles (error) per level of detail", "ms");
+    for (LoadedModel& loaded : results) {
+        std::vector<glm::vec3> positions = normalizedPositions(loaded.model, loaded.remap);
+        
+        std::string levels;
+        auto start = std::chrono::steady_clock::now();
+        MeshSimplifier simplifier(positions, loaded.indices);
+        for (int level = 1; level < LOD_COUNT; level++) {
+            simplifier.simplify(loaded.indices.size() >> level);
+            char text[32];
+            std::snprintf(text, sizeof(text), "%zu (%.4f) ", simplifier.getIndices().size() / 3, simplifier.getError());
+            levels += text;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-18s | %-60s | %8.1f\n", loaded.name.c_str(), levels.c_str(), ms);
+    }
+    
+    // Clusters of the full mesh (which reorders its triangles once more),
+    // and what the per-frame cull keeps from an overview (whole model in
+    // view) and a close-up at a 1280x720 aspect
+    std::printf("\n%-18s | %8s %9s %8s %6s | %-22s | %-22s\n", "model", "clusters", "tris/clus", "build ms",
+                "ACMR", "overview: drawn  ms", "close-up: drawn  ms");
+    for (LoadedModel& loaded : results) {
+        std::vector<glm::vec3> positions = normalizedPositions(loaded.model, loaded.remap);
+        std::vector<MeshCluster> clusters;
+        auto start = std::chrono::steady_clock::now();
+        buildClusters(positions, loaded.indices, 0, static_cast<unsigned int>(loaded.indices.size()), clusters);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        VertexCacheStats cache = analyzeVertexCache(loaded.indices, positions.size());
+        
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+        const glm::vec3 eyes[2] = { glm::vec3(0.0f, 0.0f, 4.0f), glm::vec3(0.3f, 0.2f, 1.2f) };
+        std::string views;
+        for (const glm::vec3& eye : eyes) {
+            glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.8f), glm::vec3(0.0f, 1.0f, 0.0f));
+            std::vector<DrawElementsIndirectCommand> commands;
+            const int runs = 200;
+            ClusterCullStats stats;
+            double ms = 0.0;
+            for (int run = 0; run < runs; run++) {
+                stats = cullClusters(clusters.data(), static_cast<int>(clusters.size()), projection * view, eye, true, commands);
+                ms += stats.milliseconds;
+            }
+            char text[40];
+            std::snprintf(text, sizeof(text), "%5.1f%% tris %6.3f", 100.0 * stats.triangles / (loaded.indices.size() / 3),
+                          ms / runs);
+            views += views.empty() ? "" : " | ";
+            views += text;
+        }
+        std::printf("%-18s | %8zu %9.1f %8.1f %6.3f | %s\n", loaded.name.c_str(), clusters.size(),
+                    loaded.indices.size() / 3.0 / clusters.size(), buildMs, cache.acmr, views.c_str());
+        FreeOffModel(loaded.model);
+    }
+    
+    // Inputs whose edges are all locked, where simplification must stop
+    // without collapsing anything: a lone triangle and triangle soup
+    {
+        std::vector<glm::vec3> positions = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                                             glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(3.0f, 0.0f, 0.0f),
+                                             glm::vec3(2.0f, 1.0f, 0.0f) };
+        const std::vector<unsigned int> inputs[2] = { { 0, 1, 2 }, { 0, 1, 2, 3, 4, 5 } };
+        const char* names[2] = { "single triangle", "triangle soup" };
+        for (int i = 0; i < 2; i++) {
+            MeshSimplifier simplifier(positions, inputs[i]);
+            for (int level = 1; level < LOD_COUNT; level++) {
+                simplifier.simplify(inputs[i].size() >> level);
+            }
+            bool unchanged = simplifier.getIndices() == inputs[i];
+            std::printf("%-18s | %zu triangles kept %s\n", names[i], simplifier.getIndices().size() / 3,
+                        unchanged ? "" : "(FAILED: expected no collapses)");
+            if (!unchanged) failures++;
+        }
+    }
+    
+    // A model with vertices and no faces goes through every load step with
+    // an empty index buffer, whose arena range must be a valid empty one
+    {
+        std::vector<glm::vec3> positions = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+        std::vector<unsigned int> indices;
+        optimizeVertexCache(indices, positions.size());
+        remapVertices(positions, optimizeVertexFetch(indices, positions.size()));
+        MeshSimplifier simplifier(positions, indices);
+        for (int level = 1; level < LOD_COUNT; level++) {
+            simplifier.simplify(0);
+        }
+        std::vector<MeshCluster> clusters;
+        buildClusters(positions, indices, 0, 0, clusters);
+    
+        OffsetAllocator ranges(16);
+        int handle = ranges.allocate(indices.size());
+        bool ok = handle >= 0 && ranges.getSize(handle) == 0 && simplifier.getIndices().empty() && clusters.empty();
+        ranges.defragment();
+        ok = ok && ranges.getLargestFreeRange() == 16;
+        ranges.free(handle);
+        ok = ok && ranges.getAllocationCount() == 0 && ranges.getFreeRangeCount() == 1;
+        std::printf("%-18s | %zu clusters, empty index range %s\n", "no faces", clusters.size(),
+                    ok ? "" : "(FAILED: expected an empty range)");
+        if (!ok) failures++;
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,374 @@
+// Headless scan conversion benchmark and golden-image check.
+//
+// Every workload is filled in each FillMode twice: once at a small fixed
+// size, where the result is compared pixel for pixel against the PPM stored
+// in the golden directory, and repeatedly at the benchmark size, where the
+// fill rate is measured. Exits with 1 if any image differs from its golden.
+//
+// Usage: scanline_bench [--golden DIR] [--update] [--out DIR]
+//                       [--size W H] [--iterations N] [--filter NAME]
+
+#include "raster_core.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Size of the golden images. Workloads are defined in [0, 1] coordinates,
+// so the same polygons are drawn at both sizes.
+const int GOLDEN_WIDTH = 256;
+const int GOLDEN_HEIGHT = 192;
+
+// Small deterministic generator. The standard distributions are not
+// guaranteed to give the same values on every standard library, and the
+// golden images depend on every coordinate.
+struct BenchRandom {
+    uint64_t state;
+
+    explicit BenchRandom(uint64_t seed) : state(seed) {}
+
+    uint32_t next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state >> 32);
+    }
+
+    // Uniform in [lo, hi)
+    float uniform(float lo, float hi) {
+        return lo + (hi - lo) * static_cast<float>(next() >> 8) / 16777216.0f;
+    }
+
+    glm::vec3 color() { return glm::vec3(uniform(0.2f, 1.0f), uniform(0.2f, 1.0f), uniform(0.2f, 1.0f)); }
+};
+
+// A named set of polygons. Single-polygon workloads are drawn with one
+// fillPolygon call per polygon; batch workloads with one fillPolygons call.
+struct Workload {
+    std::string name;
+    PolygonBatch polygons;
+    bool batch = false;
+};
+
+// Regular polygon, or a star when inner > 0: 2 * points vertices alternating
+// between the outer and inner radius. step > 1 connects every step-th outer
+// vertex instead, which makes self-intersecting star polygons like {5/2}.
+static std::vector<glm::vec2> makeStar(glm::vec2 center, float outer, float inner, int points,
+                                       int step = 1, float phase = 0.0f) {
+    std::vector<glm::vec2> polygon;
+    const float pi = 3.14159265358979f;
+    if (inner > 0.0f) {
+        for (int i = 0; i < 2 * points; i++) {
+            float angle = phase + pi * i / points;
+            float radius = (i % 2 == 0) ? outer : inner;
+            polygon.push_back(center + radius * glm::vec2(std::cos(angle), std::sin(angle)));
+        }
+    } else {
+        for (int i = 0; i < points; i++) {
+            float angle = phase + 2.0f * pi * ((i * step) % points) / points;
+            polygon.push_back(center + outer * glm::vec2(std::cos(angle), std::sin(angle)));
+        }
+    }
+    return polygon;
+}
+
+static std::vector<Workload> makeWorkloads() {
+    std::vector<Workload> workloads;
+    BenchRandom random(12345);
+
+    // Convex: triangles, quads and near-circles at arbitrary subpixel positions
+    Workload convex;
+    convex.name = "convex";
+    convex.polygons.addPolygon({{0.05f, 0.05f}, {0.30f, 0.12f}, {0.11f, 0.41f}}, random.color());
+    convex.polygons.addPolygon({{0.35f, 0.08f}, {0.62f, 0.06f}, {0.66f, 0.37f}, {0.38f, 0.40f}}, random.color());
+    convex.polygons.addPolygon(makeStar({0.82f, 0.24f}, 0.15f, 0.0f, 6, 1, 0.1f), random.color());
+    convex.polygons.addPolygon(makeStar({0.25f, 0.72f}, 0.22f, 0.0f, 64), random.color());
+    convex.polygons.addPolygon({{0.52f, 0.55f}, {0.97f, 0.51f}, {0.58f, 0.58f}}, random.color()); // Sliver
+    convex.polygons.addPolygon({{0.55f, 0.65f}, {0.95f, 0.65f}, {0.95f, 0.95f}, {0.55f, 0.95f}}, random.color());
+    workloads.push_back(convex);
+
+    // Concave: an L, a comb with many edges crossing each scanline, an arrow
+    Workload concave;
+    concave.name = "concave";
+    concave.polygons.addPolygon({{0.05f, 0.05f}, {0.20f, 0.05f}, {0.20f, 0.35f}, {0.40f, 0.35f},
+                                 {0.40f, 0.48f}, {0.05f, 0.48f}}, random.color());
+    std::vector<glm::vec2> comb;
+    const int teeth = 12;
+    for (int i = 0; i < teeth; i++) {
+        float x = 0.45f + 0.5f * i / teeth;
+        comb.push_back({x, 0.45f});
+        comb.push_back({x + 0.5f / (2 * teeth), 0.05f + 0.02f * (i % 3)});
+    }
+    comb.push_back({0.95f, 0.45f});
+    comb.push_back({0.95f, 0.50f});
+    comb.push_back({0.45f, 0.50f});
+    concave.polygons.addPolygon(comb, random.color());
+    concave.polygons.addPolygon({{0.10f, 0.75f}, {0.45f, 0.55f}, {0.45f, 0.68f}, {0.90f, 0.68f},
+                                 {0.90f, 0.82f}, {0.45f, 0.82f}, {0.45f, 0.95f}}, random.color());
+    workloads.push_back(concave);
+
+    // Stars: simple (non-intersecting) stars with few and many points
+    Workload stars;
+    stars.name = "star";
+    stars.polygons.addPolygon(makeStar({0.20f, 0.30f}, 0.18f, 0.07f, 5), random.color());
+    stars.polygons.addPolygon(makeStar({0.55f, 0.30f}, 0.18f, 0.10f, 8, 1, 0.2f), random.color());
+    stars.polygons.addPolygon(makeStar({0.80f, 0.70f}, 0.19f, 0.04f, 32), random.color());
+    stars.polygons.addPolygon(makeStar({0.30f, 0.72f}, 0.25f, 0.22f, 100), random.color());
+    workloads.push_back(stars);
+
+    // Self-intersecting: bow tie, pentagram, {7/3} heptagram, random loop
+    Workload crossing;
+    crossing.name = "self_intersecting";
+    crossing.polygons.addPolygon({{0.05f, 0.05f}, {0.40f, 0.40f}, {0.40f, 0.05f}, {0.05f, 0.40f}}, random.color());
+    crossing.polygons.addPolygon(makeStar({0.70f, 0.25f}, 0.22f, 0.0f, 5, 2, -1.5708f), random.color());
+    crossing.polygons.addPolygon(makeStar({0.25f, 0.72f}, 0.24f, 0.0f, 7, 3), random.color());
+    std::vector<glm::vec2> loop;
+    for (int i = 0; i < 24; i++) {
+        loop.push_back({random.uniform(0.50f, 0.98f), random.uniform(0.50f, 0.98f)});
+    }
+    crossing.polygons.addPolygon(loop, random.color());
+    workloads.push_back(crossing);
+
+    // Thousands of small random triangles and quads, as one batch
+    Workload randomBatch;
+    randomBatch.name = "random_batch";
+    randomBatch.batch = true;
+    for (int i = 0; i < 4000; i++) {
+        glm::vec2 center(random.uniform(-0.02f, 1.02f), random.uniform(-0.02f, 1.02f));
+        int count = 3 + static_cast<int>(random.next() % 2);
+        std::vector<glm::vec2> polygon;
+        for (int j = 0; j < count; j++) {
+            polygon.push_back(center + glm::vec2(random.uniform(-0.04f, 0.04f), random.uniform(-0.04f, 0.04f)));
+        }
+        randomBatch.polygons.addPolygon(polygon, random.color());
+    }
+    workloads.push_back(randomBatch);
+
+    // Screen-covering: a quad past every edge, then one on the exact corners
+    Workload covering;
+    covering.name = "screen_covering";
+    covering.polygons.addPolygon({{-0.3f, -0.2f}, {1.25f, -0.1f}, {1.3f, 1.2f}, {-0.2f, 1.3f}}, random.color());
+    covering.polygons.addPolygon({{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}}, random.color());
+    workloads.push_back(covering);
+
+    return workloads;
+}
+
+// Workload polygons scaled from [0, 1] to a width x height target
+static PolygonBatch scalePolygons(const Workload& workload, int width, int height) {
+    PolygonBatch scaled = workload.polygons;
+    for (glm::vec2& v : scaled.vertices) {
+        v *= glm::vec2(static_cast<float>(width), static_cast<float>(height));
+    }
+    return scaled;
+}
+
+// Draw the (already scaled) polygons of a workload
+static void drawWorkload(ScanConverter& converter, RasterFramebuffer& target, const Workload& workload,
+                         const PolygonBatch& polygons, FillMode mode) {
+    if (workload.batch) {
+        converter.fillPolygons(target, polygons, mode);
+        return;
+    }
+
+    std::vector<glm::vec2> polygon;
+    for (int i = 0; i < polygons.size(); i++) {
+        polygon.assign(polygons.vertices.begin() + polygons.polygonBegin(i),
+                       polygons.vertices.begin() + polygons.polygonEnd(i));
+        converter.fillPolygon(target, polygon, polygons.colors[i], mode);
+    }
+}
+
+// 8-bit RGB image, top row first
+struct Image {
+    int width = 0, height = 0;
+    std::vector<unsigned char> rgb;
+};
+
+static Image toImage(const RasterFramebuffer& source) {
+    Image image;
+    image.width = source.getWidth();
+    image.height = source.getHeight();
+    image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+    for (int y = 0; y < image.height; y++) {
+        const float* row = source.pixelPtr(0, y);
+        unsigned char* out = &image.rgb[static_cast<size_t>(y) * image.width * 3];
+        for (int i = 0; i < image.width * 3; i++) {
+            float c = std::min(std::max(row[i], 0.0f), 1.0f);
+            out[i] = static_cast<unsigned char>(c * 255.0f + 0.5f);
+        }
+    }
+    return image;
+}
+
+static bool writePPM(const std::string& path, const Image& image) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not write file: " << path << std::endl;
+        return false;
+    }
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.rgb.data()), image.rgb.size());
+    return true;
+}
+
+static bool readPPM(const std::string& path, Image& image) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string magic;
+    int maxValue = 0;
+    file >> magic >> image.width >> image.height >> maxValue;
+    file.get(); // Single whitespace before the pixel data
+    if (magic != "P6" || maxValue != 255 || image.width <= 0 || image.height <= 0) {
+        std::cerr << "Unsupported PPM file: " << path << std::endl;
+        return false;
+    }
+    image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+    file.read(reinterpret_cast<char*>(image.rgb.data()), image.rgb.size());
+    return static_cast<bool>(file);
+}
+
+// Number of pixels that differ between two images of the same size, and the
+// largest difference in any channel
+static int comparePPM(const Image& a, const Image& b, int& maxDelta) {
+    int differing = 0;
+    maxDelta = 0;
+    for (size_t i = 0; i < a.rgb.size(); i += 3) {
+        int delta = 0;
+        for (int c = 0; c < 3; c++) {
+            delta = std::max(delta, std::abs(static_cast<int>(a.rgb[i + c]) - static_cast<int>(b.rgb[i + c])));
+        }
+        if (delta > 0) differing++;
+        maxDelta = std::max(maxDelta, delta);
+    }
+    return differing;
+}
+
+static long long countCoveredPixels(const RasterFramebuffer& target) {
+    long long covered = 0;
+    for (int y = 0; y < target.getHeight(); y++) {
+        const float* row = target.pixelPtr(0, y);
+        for (int x = 0; x < target.getWidth(); x++) {
+            if (row[x * 3] != 0.0f || row[x * 3 + 1] != 0.0f || row[x * 3 + 2] != 0.0f) covered++;
+        }
+    }
+    return covered;
+}
+
+int main(int argc, char** argv) {
+    std::string goldenDir = "bench/golden";
+    std::string outDir = "";
+    std::string filter = "";
+    bool update = false;
+    int width = 1280, height = 720;
+    int iterations = 20;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--golden" && i + 1 < argc) {
+            goldenDir = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outDir = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--update") {
+            update = true;
+        } else if (arg == "--size" && i + 2 < argc) {
+            width = std::max(1, std::atoi(argv[++i]));
+            height = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--golden DIR] [--update] [--out DIR]"
+                      << " [--size W H] [--iterations N] [--filter NAME]" << std::endl;
+            return 2;
+        }
+    }
+
+    const FillMode modes[] = { FILL_INTEGER, FILL_SUBPIXEL, FILL_ANTIALIASED };
+    const char* modeNames[] = { "integer", "subpixel", "antialiased" };
+
+    std::vector<Workload> workloads = makeWorkloads();
+    ScanConverter converter;
+    RasterFramebuffer goldenTarget(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+    RasterFramebuffer benchTarget(width, height);
+    int failures = 0;
+
+    std::printf("%-18s %-12s %9s %9s %12s %10s  %s\n",
+                "workload", "mode", "polygons", "ms/fill", "Mpixels/s", "Kpolys/s", "golden");
+
+    for (const Workload& workload : workloads) {
+        if (!filter.empty() && workload.name.find(filter) == std::string::npos) continue;
+        PolygonBatch goldenPolygons = scalePolygons(workload, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+        PolygonBatch benchPolygons = scalePolygons(workload, width, height);
+
+        for (int m = 0; m < 3; m++) {
+            std::string imageName = workload.name + "_" + modeNames[m] + ".ppm";
+
+            // Correctness: compare against (or regenerate) the golden image
+            goldenTarget.clear(glm::vec3(0.0f));
+            drawWorkload(converter, goldenTarget, workload, goldenPolygons, modes[m]);
+            Image actual = toImage(goldenTarget);
+            std::string status;
+            if (update) {
+                status = writePPM(goldenDir + "/" + imageName, actual) ? "updated" : "WRITE FAILED";
+            } else {
+                Image expected;
+                int maxDelta = 0;
+                if (!readPPM(goldenDir + "/" + imageName, expected)) {
+                    status = "MISSING";
+                    failures++;
+                } else if (expected.width != actual.width || expected.height != actual.height) {
+                    status = "SIZE MISMATCH";
+                    failures++;
+                } else {
+                    int differing = comparePPM(actual, expected, maxDelta);
+                    if (differing == 0) {
+                        status = "ok";
+                    } else {
+                        status = "FAIL (" + std::to_string(differing) + " pixels, max delta " +
+                                 std::to_string(maxDelta) + ")";
+                        failures++;
+                    }
+                }
+            }
+            if (!outDir.empty()) {
+                writePPM(outDir + "/" + imageName, actual);
+            }
+
+            // Speed: median fill time at the benchmark size, without the
+            // clear. The first frame warms up the converter's buffers and
+            // is not timed.
+            benchTarget.clear(glm::vec3(0.0f));
+            drawWorkload(converter, benchTarget, workload, benchPolygons, modes[m]);
+            long long covered = countCoveredPixels(benchTarget);
+            std::vector<double> times;
+            for (int i = 0; i < iterations; i++) {
+                benchTarget.clear(glm::vec3(0.0f));
+                auto start = std::chrono::steady_clock::now();
+                drawWorkload(converter, benchTarget, workload, benchPolygons, modes[m]);
+                times.push_back(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(times.begin(), times.end());
+            double ms = times[times.size() / 2];
+
+            std::printf("%-18s %-12s %9d %9.3f %12.1f %10.1f  %s\n",
+                        workload.name.c_str(), modeNames[m], workload.polygons.size(), ms,
+                        covered / (ms * 1000.0), workload.polygons.size() / ms, status.c_str());
+        }
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " image(s) differ from the golden images in " << goldenDir << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -4,18 +4,32 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec3 aColor;  // Add color attribute
 
+// Per-instance model matrix and color tint. A single mesh is drawn with
+// these arrays disabled, so they take the constant values set by
+// Mesh::render (its model matrix and white).
+layout (location = 3) in mat4 aInstanceModel;   // Locations 3-6
+layout (location = 7) in vec4 aInstanceColor;
+
 out vec3 FragPos;
 out vec3 Normal;
 out vec3 VertexColor;  // Add color output
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Camera and light, shared by all programs (FrameConstants in
+// src/shader_program.h)
+layout (std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
 
 void main() {
+    mat4 model = aInstanceModel;
+    
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
-    VertexColor = aColor;  // Pass color to fragment shader
+    VertexColor = aColor * aInstanceColor.rgb;  // Pass color to fragment shader
     
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
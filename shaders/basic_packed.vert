@@ -0,0 +1,50 @@
+#version 330 core
+
+// basic.vert for the compact vertex layout (PackedMeshVertex in
+// src/vertex_packing.h). The attributes arrive as normalized integers.
+layout (location = 0) in vec3 aPos;     // snorm16, [-1, 1] across the bounding box
+layout (location = 1) in vec2 aNormal;  // snorm16, octahedral-encoded
+layout (location = 2) in vec3 aColor;   // unorm8
+
+// Per-instance model matrix and color tint. A single mesh is drawn with
+// these arrays disabled, so they take the constant values set by
+// Mesh::render (its model matrix and white).
+layout (location = 3) in mat4 aInstanceModel;   // Locations 3-6
+layout (location = 7) in vec4 aInstanceColor;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 VertexColor;
+
+// Camera and light, shared by all programs (FrameConstants in
+// src/shader_program.h)
+layout (std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// Bounding box the positions were quantized to
+uniform vec3 positionCenter;
+uniform vec3 positionHalfExtent;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+void main() {
+    mat4 model = aInstanceModel;
+    
+    vec3 position = positionCenter + positionHalfExtent * aPos;
+    
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(model))) * octDecode(aNormal);
+    VertexColor = aColor * aInstanceColor.rgb;
+    
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 430 core
+
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D screenTexture;
+
+void main() {
+    FragColor = texture(screenTexture, TexCoord);
+}
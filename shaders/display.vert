@@ -0,0 +1,13 @@
+#version 430 core
+
+// Full-screen quad showing a CPU-rendered framebuffer (rasterizer, scan
+// line, software renderer and ray tracer views)
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+
+void main() {
+    gl_Position = vec4(aPos, 0.0, 1.0);
+    TexCoord = aTexCoord;
+}
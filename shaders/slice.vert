@@ -8,8 +8,15 @@ out vec3 FragPos;
 
 // Uniforms
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Same camera as the mesh (FrameConstants in src/shader_program.h)
+layout (std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
 
 void main() {
     // Calculate world-space position
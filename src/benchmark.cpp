@@ -0,0 +1,267 @@
+#include "benchmark.h"
+#include "gpu_timer.h"
+#include "profiler.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+Benchmark::Benchmark()
+    : modelPath("models/1grm.off"), width(1280), height(720), currentRun(0), currentFrame(0) {
+}
+
+bool Benchmark::parseView(const std::string& name, ViewMode& view, bool& softwareRendering) {
+    softwareRendering = false;
+    if (name == "3d") {
+        view = VIEW_3D;
+    } else if (name == "software") {
+        view = VIEW_3D;
+        softwareRendering = true;
+    } else if (name == "slice") {
+        view = VIEW_SLICE;
+    } else if (name == "raster") {
+        view = VIEW_RASTER;
+    } else if (name == "scanline") {
+        view = VIEW_SCANLINE;
+    } else if (name == "raytrace") {
+        view = VIEW_RAYTRACE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Benchmark::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open benchmark script: " << path << std::endl;
+        return false;
+    }
+    scriptPath = path;
+    
+    // The settings of the next run, changed by the commands before it
+    BenchmarkRun next;
+    next.viewName = "3d";
+    next.view = VIEW_3D;
+    next.softwareRendering = false;
+    next.forcedLod = -1;
+    next.frames = 0;
+    next.warmup = BENCHMARK_DEFAULT_WARMUP_FRAMES;
+    next.sweepSlice = false;
+    next.sliceNormal = glm::vec3(0.0f, 1.0f, 0.0f);
+    next.sliceFrom = next.sliceTo = 0.0f;
+    next.rayTrace = { 3, true, true, 2 };
+    
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        std::string command;
+        if (!(in >> command)) continue;
+        
+        bool ok = true;
+        if (command == "model") {
+            ok = static_cast<bool>(in >> modelPath) && runs.empty();
+        } else if (command == "size") {
+            ok = static_cast<bool>(in >> width >> height) && width > 0 && height > 0 && runs.empty();
+        } else if (command == "path") {
+            next.path.clear();
+        } else if (command == "key") {
+            CameraKey key;
+            ok = static_cast<bool>(in >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch);
+            next.path.push_back(key);
+        } else if (command == "view") {
+            ok = (in >> next.viewName) && parseView(next.viewName, next.view, next.softwareRendering);
+        } else if (command == "lod") {
+            ok = static_cast<bool>(in >> next.forcedLod);
+        } else if (command == "slice") {
+            ok = static_cast<bool>(in >> next.sliceNormal.x >> next.sliceNormal.y >> next.sliceNormal.z >>
+                                   next.sliceFrom >> next.sliceTo) && glm::length(next.sliceNormal) > 0.0f;
+            next.sweepSlice = true;
+        } else if (command == "noslice") {
+            next.sweepSlice = false;
+        } else if (command == "raytrace") {
+            BenchmarkRayTrace& rayTrace = next.rayTrace;
+            ok = static_cast<bool>(in >> rayTrace.maxDepth >> rayTrace.shadows >> rayTrace.reflections >>
+                                   rayTrace.shadowLod) && rayTrace.maxDepth > 0;
+        } else if (command == "warmup") {
+            ok = (in >> next.warmup) && next.warmup >= 0;
+        } else if (command == "run") {
+            ok = (in >> next.frames) && next.frames > 0;
+            if (!(in >> next.name)) {
+                next.name = "run " + std::to_string(runs.size() + 1);
+            }
+            runs.push_back(next);
+        } else {
+            ok = false;
+        }
+        
+        if (!ok) {
+            std::cerr << path << ":" << lineNumber << ": invalid benchmark command: " << line << std::endl;
+            return false;
+        }
+    }
+    
+    if (runs.empty()) {
+        std::cerr << path << ": benchmark script has no runs" << std::endl;
+        return false;
+    }
+    results.assign(runs.size(), RunResult());
+    return true;
+}
+
+BenchmarkFrame Benchmark::beginFrame() const {
+    const BenchmarkRun& run = runs[currentRun];
+    BenchmarkFrame frame;
+    frame.run = &run;
+    frame.firstOfRun = currentFrame == 0;
+    
+    // Warmup frames stay at the start of the path and the sweep
+    int measured = std::max(currentFrame - run.warmup, 0);
+    float t = run.frames > 1 ? measured / float(run.frames - 1) : 0.0f;
+    frame.sliceDistance = glm::mix(run.sliceFrom, run.sliceTo, t);
+    
+    frame.moveCamera = !run.path.empty();
+    if (frame.moveCamera) {
+        float position = t * (run.path.size() - 1);
+        size_t key = std::min(static_cast<size_t>(position), run.path.size() - 1);
+        size_t nextKey = std::min(key + 1, run.path.size() - 1);
+        float blend = position - key;
+        const CameraKey& a = run.path[key];
+        const CameraKey& b = run.path[nextKey];
+        frame.camera.position = glm::mix(a.position, b.position, blend);
+        frame.camera.yaw = glm::mix(a.yaw, b.yaw, blend);
+        frame.camera.pitch = glm::mix(a.pitch, b.pitch, blend);
+    }
+    return frame;
+}
+
+void Benchmark::endFrame() {
+    const BenchmarkRun& run = runs[currentRun];
+    RunResult& result = results[currentRun];
+    int64_t now = Profiler::now();
+    
+    // GPU results arrive a frame or two late; take each one once. The
+    // results of warmup frames are skipped along with the frames.
+    for (const GpuTimer* timer : GpuTimer::getTimers()) {
+        int64_t& taken = gpuSampleTimes[timer];
+        if (timer->getSampleTime() <= taken) continue;
+        taken = timer->getSampleTime();
+        if (currentFrame >= run.warmup && now - taken < GPU_TIMER_STALE_NS) {
+            result.gpuPasses[timer->getName()].push_back(timer->getMilliseconds());
+        }
+    }
+    
+    const std::vector<ProfileFrame>& frames = Profiler::getFrames();
+    if (currentFrame >= run.warmup && !frames.empty()) {
+        const ProfileFrame& frame = frames.back();
+        size_t index = result.frameTimes.size();
+        result.frameTimes.push_back((frame.end - frame.start) / 1e6);
+        
+        // Scopes that ran several times, or on several threads, add up
+        for (const ProfileEvent& event : Profiler::getFrameEvents(frame)) {
+            std::vector<double>& times = result.scopes[event.name];
+            times.resize(index + 1, 0.0);
+            times[index] += (event.end - event.start) / 1e6;
+        }
+        for (auto& scope : result.scopes) {
+            scope.second.resize(index + 1, 0.0);
+        }
+    }
+    
+    if (++currentFrame == run.warmup + run.frames) {
+        currentRun++;
+        currentFrame = 0;
+    }
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+}
+
+static void writeJsonString(FILE* file, const std::string& text) {
+    fputc('"', file);
+    for (char c : text) {
+        if (c == '"' || c == '\\') fputc('\\', file);
+        if (static_cast<unsigned char>(c) >= 0x20) fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+static void writeSummary(FILE* file, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    double total = 0.0;
+    for (double value : values) total += value;
+    if (values.empty()) {
+        fprintf(file, "{\"samples\":0}");
+        return;
+    }
+    fprintf(file, "{\"samples\":%d,\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+            (int)values.size(), total / values.size(), percentile(values, 50), percentile(values, 95),
+            percentile(values, 99), values.back());
+}
+
+static void writeSummaries(FILE* file, const std::map<std::string, std::vector<double>>& series) {
+    fprintf(file, "{");
+    for (auto it = series.begin(); it != series.end(); ++it) {
+        fprintf(file, "%s\n        ", it == series.begin() ? "" : ",");
+        writeJsonString(file, it->first);
+        fprintf(file, ":");
+        writeSummary(file, it->second);
+    }
+    fprintf(file, "}");
+}
+
+// Times are in milliseconds: frame times, the time per frame of every
+// profiler scope summed over its calls and threads, and GPU pass times
+bool Benchmark::writeReport(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to write benchmark report: " << path << std::endl;
+        return false;
+    }
+    
+    const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    fprintf(file, "{\n  \"script\":");
+    writeJsonString(file, scriptPath);
+    fprintf(file, ",\n  \"model\":");
+    writeJsonString(file, modelPath);
+    fprintf(file, ",\n  \"width\":%d,\n  \"height\":%d,\n  \"renderer\":", width, height);
+    writeJsonString(file, renderer ? renderer : "");
+    fprintf(file, ",\n  \"version\":");
+    writeJsonString(file, version ? version : "");
+    fprintf(file, ",\n  \"runs\":[");
+    
+    std::vector<double> allFrameTimes;
+    for (size_t i = 0; i < runs.size(); i++) {
+        const BenchmarkRun& run = runs[i];
+        const RunResult& result = results[i];
+        allFrameTimes.insert(allFrameTimes.end(), result.frameTimes.begin(), result.frameTimes.end());
+        
+        fprintf(file, "%s\n    {\"name\":", i == 0 ? "" : ",");
+        writeJsonString(file, run.name);
+        fprintf(file, ",\"view\":");
+        writeJsonString(file, run.viewName);
+        fprintf(file, ",\"frames\":%d,\n      \"frame_ms\":", run.frames);
+        writeSummary(file, result.frameTimes);
+        fprintf(file, ",\n      \"scopes_ms\":");
+        writeSummaries(file, result.scopes);
+        fprintf(file, ",\n      \"gpu_ms\":");
+        writeSummaries(file, result.gpuPasses);
+        fprintf(file, "}");
+    }
+    
+    fprintf(file, "\n  ],\n  \"frame_ms\":");
+    writeSummary(file, allFrameTimes);
+    fprintf(file, "\n}\n");
+    fclose(file);
+    return true;
+}
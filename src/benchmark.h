@@ -0,0 +1,111 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include "gui.h"
+
+// Frames at the start of every run that are rendered but not measured,
+// unless the script says otherwise (shader compiles, first traces)
+const int BENCHMARK_DEFAULT_WARMUP_FRAMES = 5;
+
+// One point of a camera path; yaw and pitch in degrees as in main.cpp
+struct CameraKey {
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+// Ray tracer settings of a run
+struct BenchmarkRayTrace {
+    int maxDepth;
+    bool shadows, reflections;
+    int shadowLod;
+};
+
+// A block of frames rendered in one view with fixed settings. The camera
+// follows the path from its first to its last key over the frames, and a
+// slice sweep moves the first slice plane from sliceFrom to sliceTo.
+struct BenchmarkRun {
+    std::string name;
+    std::string viewName;       // As written in the script
+    ViewMode view;
+    bool softwareRendering;
+    int forcedLod;
+    int frames, warmup;
+    std::vector<CameraKey> path;
+    bool sweepSlice;
+    glm::vec3 sliceNormal;
+    float sliceFrom, sliceTo;
+    BenchmarkRayTrace rayTrace;
+};
+
+// What main applies before updating and rendering a benchmark frame
+struct BenchmarkFrame {
+    const BenchmarkRun* run;
+    bool firstOfRun;
+    bool moveCamera;        // False while the run has no camera path
+    CameraKey camera;
+    float sliceDistance;
+};
+
+// Scripted, unattended benchmark of the whole application. A script is a
+// text file with one command per line ('#' starts a comment):
+//
+//   model PATH                     model to load (before any run)
+//   size WIDTH HEIGHT              window size (before any run)
+//   path                           start a new camera path...
+//   key X Y Z YAW PITCH            ...and append a key to it
+//   view 3d|software|slice|raster|scanline|raytrace
+//   lod N                          forced level of detail, -1 for auto
+//   slice NX NY NZ FROM TO         sweep the slice plane over each run
+//   noslice                        leave the slice plane alone
+//   raytrace DEPTH SHADOWS REFLECTIONS SHADOWLOD
+//   warmup N                       unmeasured frames before each run
+//   run N [NAME]                   render N measured frames
+//
+// Settings carry over from one run to the next. Every frame is driven by
+// the script alone, so two builds render the same frames. Frame times
+// and the time of every profiler scope and GPU pass are reported per run
+// as a JSON file with mean, p50, p95, p99 and max.
+class Benchmark {
+private:
+    struct RunResult {
+        std::vector<double> frameTimes;
+        std::map<std::string, std::vector<double>> scopes;     // Per frame, 0 where the scope did not run
+        std::map<std::string, std::vector<double>> gpuPasses;  // Only frames with a new result
+    };
+    
+    std::string scriptPath;
+    std::string modelPath;
+    int width, height;
+    std::vector<BenchmarkRun> runs;
+    std::vector<RunResult> results;
+    
+    size_t currentRun;
+    int currentFrame;       // Within the run, warmup frames first
+    std::map<const GpuTimer*, int64_t> gpuSampleTimes;    // Last result taken from each timer
+    
+    static bool parseView(const std::string& name, ViewMode& view, bool& softwareRendering);
+
+public:
+    Benchmark();
+    
+    // Read a script; reports errors with their line to std::cerr
+    bool load(const std::string& path);
+    
+    const std::string& getModelPath() const { return modelPath; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    bool isFinished() const { return currentRun >= runs.size(); }
+    
+    // Around each frame of the main loop: beginFrame says what to render,
+    // endFrame (after Profiler::endFrame) records the frame's timings
+    BenchmarkFrame beginFrame() const;
+    void endFrame();
+    
+    bool writeReport(const std::string& path) const;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,76 @@
+#include "canvas_display.h"
+#include "profiler.h"
+
+// External variables from main.cpp
+extern ShaderManager* shader_manager;
+
+CanvasDisplay::CanvasDisplay(const char* timerName, int width, int height)
+    : width(width), height(height), presentTimer(timerName) {
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    float quadVertices[] = {
+        // Positions     // Texture Coords
+        -1.0f,  1.0f,    0.0f, 1.0f,
+        -1.0f, -1.0f,    0.0f, 0.0f,
+         1.0f, -1.0f,    1.0f, 0.0f,
+        
+        -1.0f,  1.0f,    0.0f, 1.0f,
+         1.0f, -1.0f,    1.0f, 0.0f,
+         1.0f,  1.0f,    1.0f, 1.0f
+    };
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    
+    // The texture is always on unit 0
+    displayShader = shader_manager->getProgram(DISPLAY_VERTEX_SHADER_PATH, DISPLAY_FRAGMENT_SHADER_PATH);
+    displayShader->use();
+    displayShader->setInt("screenTexture", 0);
+    glUseProgram(0);
+}
+
+CanvasDisplay::~CanvasDisplay() {
+    glDeleteTextures(1, &texture);
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+}
+
+void CanvasDisplay::resize(int w, int h) {
+    width = w;
+    height = h;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CanvasDisplay::present(const float* pixels) {
+    GpuTimerScope gpuScope(presentTimer);
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (pixels) {
+        PROFILE_SCOPE("texture upload");
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_FLOAT, pixels);
+    }
+    
+    // The quad covers the whole default framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    displayShader->use();
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
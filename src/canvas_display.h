@@ -0,0 +1,37 @@
+#ifndef CANVAS_DISPLAY_H
+#define CANVAS_DISPLAY_H
+
+#include <GL/glew.h>
+#include "gpu_timer.h"
+#include "shader_manager.h"
+
+// Shows a CPU-drawn RGB float canvas on a full-screen quad: the texture
+// the canvas is uploaded to, the quad and the display shader. Shared by
+// every view that renders on the CPU, so the upload and the present are
+// timed, on the CPU and the GPU, in this one place.
+class CanvasDisplay {
+private:
+    int width, height;
+    GLuint texture;
+    GLuint quadVAO, quadVBO;
+    ShaderProgram* displayShader;
+    GpuTimer presentTimer;
+
+public:
+    // timerName names the GPU pass in the profiler, e.g. the view's render
+    CanvasDisplay(const char* timerName, int width, int height);
+    ~CanvasDisplay();
+    
+    CanvasDisplay(const CanvasDisplay&) = delete;
+    CanvasDisplay& operator=(const CanvasDisplay&) = delete;
+    
+    // Reallocate the texture; the next present must upload
+    void resize(int width, int height);
+    
+    // Upload pixels (width * height RGB floats, bottom row first), unless
+    // null because the canvas is unchanged, and draw the texture over the
+    // default framebuffer
+    void present(const float* pixels);
+};
+
+#endif // CANVAS_DISPLAY_H
@@ -0,0 +1,57 @@
+#include "gpu_timer.h"
+#include "profiler.h"
+#include <algorithm>
+
+// Timers are created and used on the main thread only
+static std::vector<GpuTimer*> timers;
+
+GpuTimer::GpuTimer(const char* name)
+    : name(name), current(0), running(false), milliseconds(0.0), sampleTime(-1) {
+    glGenQueries(4, &queries[0][0]);
+    pending[0] = pending[1] = false;
+    timers.push_back(this);
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(4, &queries[0][0]);
+    timers.erase(std::find(timers.begin(), timers.end(), this));
+}
+
+// Read back every pair whose end timestamp has arrived
+void GpuTimer::collect() {
+    for (int pair = 0; pair < 2; pair++) {
+        if (!pending[pair]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[pair][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(queries[pair][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[pair][1], GL_QUERY_RESULT, &end);
+        milliseconds = (end - start) / 1e6;
+        sampleTime = Profiler::now();
+        pending[pair] = false;
+    }
+}
+
+void GpuTimer::begin() {
+    collect();
+    running = Profiler::isEnabled() && !pending[current];
+    if (running) {
+        glQueryCounter(queries[current][0], GL_TIMESTAMP);
+    }
+}
+
+void GpuTimer::end() {
+    if (!running) {
+        return;
+    }
+    glQueryCounter(queries[current][1], GL_TIMESTAMP);
+    pending[current] = true;
+    current ^= 1;
+    running = false;
+}
+
+const std::vector<GpuTimer*>& GpuTimer::getTimers() {
+    return timers;
+}
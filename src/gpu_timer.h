@@ -0,0 +1,62 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+// Results older than this (in nanoseconds) belong to passes no longer drawn
+const int64_t GPU_TIMER_STALE_NS = 500000000;
+
+// GPU time of one render pass, measured with a pair of GL_TIMESTAMP queries
+// around it. There are two query pairs used in turn, so a frame's result is
+// read back while the next frame is measured, once the driver reports it
+// available; nothing ever waits on the GPU. If both pairs are still in
+// flight the pass simply goes unmeasured that frame. Timestamps rather than
+// GL_TIME_ELAPSED let passes nest, e.g. the mesh inside the slice view.
+//
+// Timers only measure while the profiler is enabled. Every live timer is
+// listed by getTimers() for the profiler window.
+class GpuTimer {
+private:
+    const char* name;
+    GLuint queries[2][2];       // [pair][begin, end]
+    bool pending[2];
+    int current;
+    bool running;
+    double milliseconds;        // Latest result
+    int64_t sampleTime;         // Profiler::now() when it was read, -1 before
+    
+    void collect();
+
+public:
+    explicit GpuTimer(const char* name);
+    ~GpuTimer();
+    
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+    
+    void begin();
+    void end();
+    
+    const char* getName() const { return name; }
+    double getMilliseconds() const { return milliseconds; }
+    int64_t getSampleTime() const { return sampleTime; }
+    
+    static const std::vector<GpuTimer*>& getTimers();
+};
+
+// Times the rest of the enclosing block on the GPU
+class GpuTimerScope {
+private:
+    GpuTimer& timer;
+
+public:
+    explicit GpuTimerScope(GpuTimer& timer) : timer(timer) { timer.begin(); }
+    ~GpuTimerScope() { timer.end(); }
+    
+    GpuTimerScope(const GpuTimerScope&) = delete;
+    GpuTimerScope& operator=(const GpuTimerScope&) = delete;
+};
+
+#endif // GPU_TIMER_H
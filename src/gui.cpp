@@ -1,10 +1,16 @@
 #include "gui.h"
+#include "gpu_timer.h"
+#include "mesh_arena.h"
+#include "model_cache.h"
+#include "process_memory.h"
+#include "profiler.h"
 #include "../imgui/imgui.h"
 #include "../imgui/backends/imgui_impl_glfw.h"
 #include "../imgui/backends/imgui_impl_opengl3.h"
 #include <GLFW/glfw3.h> // Add GLFW header
 #include <glm/glm.hpp>
 #include <string>
+#include <algorithm>
 
 // External camera variables from main.cpp
 extern float camera_pos[3];
@@ -13,17 +19,21 @@ extern glm::vec3 camera_up;
 extern glm::vec3 camera_right; // Add this
 extern glm::vec3 world_up;     // Add this
 extern GLFWwindow* window;     // Add this
+extern ShaderManager* shader_manager;
+extern MeshArena* mesh_arena;
+extern ModelCache* model_cache;
 
 GUI::GUI() {
     // Initialize GUI state
     showDemoWindow = false;
     showMetricsWindow = false;
+    showProfilerWindow = false;
     showAppMainMenuBar = true;
 }
 
 void GUI::render(ViewMode* currentView, Mesh* mesh, MeshSlicer* slicer, 
                 Rasterizer* rasterizer, ScanLineRenderer* scanline, 
-                RayTracer* raytracer) {
+                RayTracer* raytracer, SoftwareRenderer* softrenderer) {
     // Main menu bar at the top of the window
     if (showAppMainMenuBar) {
         renderMainMenuBar();
@@ -92,6 +102,105 @@ void GUI::render(ViewMode* currentView, Mesh* mesh, MeshSlicer* slicer,
                 mesh->setScale(glm::vec3(scale[0], scale[1], scale[2]));
             }
             
+            // Vertex cache efficiency of the load-time index reordering
+            ImGui::Text("Vertex cache ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f",
+                        mesh->getCacheStatsBefore().acmr, mesh->getCacheStatsAfter().acmr,
+                        mesh->getCacheStatsBefore().atvr, mesh->getCacheStatsAfter().atvr);
+            
+            // GPU vertex layout: 36-byte floats or 16-byte quantized
+            bool compactVertices = mesh->getCompactVertices();
+            if (ImGui::Checkbox("Compact Vertex Format", &compactVertices)) {
+                mesh->setCompactVertices(compactVertices);
+            }
+            ImGui::Text("Vertex buffer: %.2f MB", mesh->getVertexBufferBytes() / (1024.0 * 1024.0));
+            
+            // Level of detail: picked from the projected size, or forced
+            const char* lodNames[] = { "Auto", "LOD 0", "LOD 1", "LOD 2", "LOD 3", "LOD 4", "LOD 5" };
+            int lodChoice = mesh->getForcedLod() + 1;
+            if (ImGui::Combo("Level of Detail", &lodChoice, lodNames,
+                             std::min(mesh->getLodCount() + 1, (int)IM_ARRAYSIZE(lodNames)))) {
+                mesh->setForcedLod(lodChoice - 1);
+            }
+            const MeshLod& lod = mesh->getLod(mesh->getCurrentLod());
+            if (!mesh->getInstancing()) ImGui::Text("Drawing LOD %d: %u triangles, error %.4f", mesh->getCurrentLod(), lod.indexCount / 3, lod.error);
+            
+            // Frustum and back-face cone culling of the LOD's clusters
+            bool clusterCulling = mesh->getClusterCulling();
+            if (ImGui::Checkbox("Cluster Culling", &clusterCulling)) {
+                mesh->setClusterCulling(clusterCulling);
+            }
+            if (clusterCulling) {
+                const ClusterCullStats& cull = mesh->getCullStats();
+                ImGui::Text("%d of %d clusters drawn (%d outside frustum, %d back-facing)",
+                            cull.visible, cull.clusters, cull.frustumCulled, cull.backfaceCulled);
+                ImGui::Text("%lld triangles in %d draws, culled in %.3f ms", cull.triangles, cull.commands, cull.milliseconds);
+            }
+            
+            // Many copies of the mesh in one draw, culled on the GPU
+            bool instancing = mesh->getInstancing();
+            if (ImGui::Checkbox("Instanced Grid", &instancing)) {
+                mesh->setInstancing(instancing);
+            }
+            if (instancing) {
+                bool changed = ImGui::SliderInt("Instances", &instanceCount, 1, MESH_MAX_INSTANCES);
+                changed |= ImGui::SliderFloat("Spacing", &instanceSpacing, 1.0f, 4.0f, "%.1f diameters");
+                if (changed || mesh->getInstanceCount() == 0) {
+                    mesh->setInstances(Mesh::makeInstanceGrid(instanceCount,
+                                                              instanceSpacing * 2.0f * mesh->getBoundingRadius()));
+                }
+                ImGui::Text("%d instances, culled and given a LOD each on the GPU", mesh->getInstanceCount());
+            }
+            
+            ImGui::Text("Shader programs: %d (%d compiled, %d from binary cache)", shader_manager->getProgramCount(),
+                        shader_manager->getCompiledCount(), shader_manager->getBinaryLoadCount());
+            
+            // Shared vertex and index buffers all meshes are carved out of
+            ImGui::Text("Mesh arena: vertices %.1f / %.1f MB, indices %.1f / %.1f MB",
+                        mesh_arena->getVertexBytesUsed() / (1024.0 * 1024.0),
+                        mesh_arena->getVertexBytesCapacity() / (1024.0 * 1024.0),
+                        mesh_arena->getIndexBytesUsed() / (1024.0 * 1024.0),
+                        mesh_arena->getIndexBytesCapacity() / (1024.0 * 1024.0));
+            ImGui::Text("%d ranges, %d defragmentations", mesh_arena->getAllocationCount(),
+                        mesh_arena->getDefragmentCount());
+            
+            // Loaded models kept resident for switching back, by LRU
+            const double MB = 1024.0 * 1024.0;
+            int ramBudgetMB = static_cast<int>(model_cache->getRamBudget() >> 20);
+            int vramBudgetMB = static_cast<int>(model_cache->getVramBudget() >> 20);
+            bool budgetChanged = ImGui::SliderInt("Model RAM Budget", &ramBudgetMB, 64, 8192, "%d MB");
+            budgetChanged |= ImGui::SliderInt("Model VRAM Budget", &vramBudgetMB, 32, 4096, "%d MB");
+            if (budgetChanged) {
+                model_cache->setBudget(static_cast<size_t>(ramBudgetMB) << 20, static_cast<size_t>(vramBudgetMB) << 20);
+            }
+            ImGui::Text("Model cache: RAM %.1f MB, VRAM %.1f MB (%d hits, %d misses, %d evictions)",
+                        model_cache->getRamUsed() / MB, model_cache->getVramUsed() / MB,
+                        model_cache->getHits(), model_cache->getMisses(), model_cache->getEvictions());
+            ImGui::Text("Process RSS: %.1f MB (peak %.1f MB)", getResidentBytes() / MB, getPeakResidentBytes() / MB);
+            if (ImGui::TreeNode("Resident Models", "Resident models (%d)", (int)model_cache->getModels().size())) {
+                for (const CachedModel& model : model_cache->getModels()) {
+                    const ModelMemory& memory = model.memory;
+                    ImGui::Text("%s: vertices %.2f, indices %.2f, clusters %.2f, GPU %.2f MB", model.path.c_str(),
+                                memory.vertices / MB, memory.indices / MB, memory.acceleration / MB, memory.gpu / MB);
+                    ImGui::Text("    loading: RSS +%.2f MB at peak, +%.2f MB after",
+                                memory.loadPeak / MB, memory.loadResident / MB);
+                }
+                ImGui::TreePop();
+            }
+            
+            // Draw the mesh on the CPU instead of with OpenGL
+            ImGui::Separator();
+            ImGui::Checkbox("Software Rendering", &softwareRendering);
+            if (softwareRendering) {
+                const char* shadingNames[] = { "Gouraud", "Phong" };
+                if (ImGui::Combo("Shading", &softwareShading, shadingNames, IM_ARRAYSIZE(shadingNames))) {
+                    softrenderer->setShadingMode(static_cast<ShadingMode>(softwareShading));
+                }
+                
+                const SoftRenderStats& stats = softrenderer->getStats();
+                ImGui::Text("%.2f ms, %d of %d triangles rasterized", stats.milliseconds, stats.rasterized, stats.triangles);
+                ImGui::Text("%lld pixels shaded, %lld blocks rejected by Hi-Z", stats.pixelsShaded, stats.blocksRejected);
+            }
+            
             break;
     }
     
@@ -124,6 +233,10 @@ void GUI::render(ViewMode* currentView, Mesh* mesh, MeshSlicer* slicer,
     if (showMetricsWindow) {
         ImGui::ShowMetricsWindow(&showMetricsWindow);
     }
+    
+    if (showProfilerWindow) {
+        renderProfilerWindow();
+    }
 }
 
 void GUI::renderMainMenuBar() {
@@ -167,6 +280,7 @@ void GUI::renderMainMenuBar() {
             
             ImGui::MenuItem("Show Demo Window", NULL, &showDemoWindow);
             ImGui::MenuItem("Show Metrics", NULL, &showMetricsWindow);
+            ImGui::MenuItem("Show Profiler", NULL, &showProfilerWindow);
             ImGui::EndMenu();
         }
         
@@ -480,6 +594,15 @@ void GUI::renderScanConversionControls(ScanLineRenderer* scanline, int width, in
         scanline->setFillColor(glm::vec3(fillColor[0], fillColor[1], fillColor[2]));
     }
     
+    // Vertex precision: whole pixels, subpixel vertices sampled at pixel
+    // centers (polygons sharing an edge tile without gaps or overlap), or
+    // anti-aliased edges
+    const char* fillModeNames[] = { "Integer", "Subpixel", "Anti-aliased" };
+    int fillModeIndex = static_cast<int>(scanline->getFillMode());
+    if (ImGui::Combo("Precision", &fillModeIndex, fillModeNames, IM_ARRAYSIZE(fillModeNames))) {
+        scanline->setFillMode(static_cast<FillMode>(fillModeIndex));
+    }
+    
     // Update polygon if vertices changed
     if (verticesChanged) {
         // Clear the current polygon
@@ -487,8 +610,8 @@ void GUI::renderScanConversionControls(ScanLineRenderer* scanline, int width, in
         
         // Add the vertices (converting from normalized to pixel coordinates)
         for (int i = 0; i < numPolygonVertices; i++) {
-            int x = static_cast<int>(polygonVertices[i][0] * width);
-            int y = static_cast<int>(polygonVertices[i][1] * height);
+            float x = polygonVertices[i][0] * width;
+            float y = polygonVertices[i][1] * height;
             scanline->addVertex(glm::vec2(x, y));
         }
     }
@@ -504,8 +627,8 @@ void GUI::renderScanConversionControls(ScanLineRenderer* scanline, int width, in
         // Update the scanline renderer
         scanline->clearPolygon();
         for (int i = 0; i < numPolygonVertices; i++) {
-            int x = static_cast<int>(polygonVertices[i][0] * width);
-            int y = static_cast<int>(polygonVertices[i][1] * height);
+            float x = polygonVertices[i][0] * width;
+            float y = polygonVertices[i][1] * height;
             scanline->addVertex(glm::vec2(x, y));
         }
     }
@@ -516,8 +639,8 @@ void GUI::renderScanConversionControls(ScanLineRenderer* scanline, int width, in
         
         // Add the vertices (converting from normalized to pixel coordinates)
         for (int i = 0; i < numPolygonVertices; i++) {
-            int x = static_cast<int>(polygonVertices[i][0] * width);
-            int y = static_cast<int>(polygonVertices[i][1] * height);
+            float x = polygonVertices[i][0] * width;
+            float y = polygonVertices[i][1] * height;
             scanline->addVertex(glm::vec2(x, y));
         }
         
@@ -546,8 +669,8 @@ void GUI::renderScanConversionControls(ScanLineRenderer* scanline, int width, in
         // Update the scanline renderer
         scanline->clearPolygon();
         for (int i = 0; i < numPolygonVertices; i++) {
-            int x = static_cast<int>(polygonVertices[i][0] * width);
-            int y = static_cast<int>(polygonVertices[i][1] * height);
+            float x = polygonVertices[i][0] * width;
+            float y = polygonVertices[i][1] * height;
             scanline->addVertex(glm::vec2(x, y));
         }
         
@@ -555,6 +678,64 @@ void GUI::renderScanConversionControls(ScanLineRenderer* scanline, int width, in
         scanline->clear(glm::vec3(0.1f, 0.1f, 0.1f));
         scanline->update();
     }
+    
+    // Batch scan conversion of many polygons at once
+    ImGui::Separator();
+    ImGui::Text("Batch Fill");
+    ImGui::SliderInt("Polygon Count", &batchPolygonCount, 100, 20000);
+    
+    const char* fillRuleNames[] = { "Even-Odd", "Non-Zero" };
+    if (ImGui::Combo("Fill Rule", &batchFillRule, fillRuleNames, IM_ARRAYSIZE(fillRuleNames))) {
+        // Re-fill the existing batch with the new rule
+        PolygonBatch batch = scanline->getBatch();
+        batch.fillRule = static_cast<FillRule>(batchFillRule);
+        scanline->setBatch(batch);
+    }
+    
+    if (ImGui::Button("Fill Random Polygons")) {
+        // Random small polygons; some get shuffled vertices so they
+        // self-intersect and the two fill rules differ visibly
+        PolygonBatch batch;
+        batch.fillRule = static_cast<FillRule>(batchFillRule);
+        std::vector<glm::vec2> polygon;
+        
+        for (int i = 0; i < batchPolygonCount; i++) {
+            float centerX = static_cast<float>(rand() % width);
+            float centerY = static_cast<float>(rand() % height);
+            int sides = 3 + rand() % 6;
+            
+            polygon.clear();
+            for (int j = 0; j < sides; j++) {
+                float angle = static_cast<float>(j) * (2.0f * 3.14159f / sides);
+                float radius = 5.0f + static_cast<float>(rand() % 40);
+                polygon.push_back(glm::vec2(centerX + radius * std::cos(angle),
+                                            centerY + radius * std::sin(angle)));
+            }
+            if (rand() % 4 == 0) {
+                std::swap(polygon[0], polygon[sides / 2]);
+            }
+            
+            glm::vec3 color(rand() / static_cast<float>(RAND_MAX),
+                            rand() / static_cast<float>(RAND_MAX),
+                            rand() / static_cast<float>(RAND_MAX));
+            batch.addPolygon(polygon, color);
+        }
+        
+        scanline->setBatch(batch);
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::Button("Clear Batch")) {
+        scanline->clearBatch();
+    }
+    
+    // Throughput of the last batch fill
+    if (!scanline->getBatch().empty()) {
+        const BatchFillStats& stats = scanline->getBatchStats();
+        ImGui::Text("%d polygons, %lld pixels in %.2f ms", stats.polygons, stats.pixels, stats.milliseconds);
+        ImGui::Text("%.2f Mpolygons/s, %.1f Mpixels/s",
+                    stats.polygonsPerSecond() / 1.0e6, stats.pixelsPerSecond() / 1.0e6);
+    }
 }
 
 void GUI::renderRayTracingControls(RayTracer* raytracer, Mesh* mesh) {
@@ -576,6 +757,11 @@ void GUI::renderRayTracingControls(RayTracer* raytracer, Mesh* mesh) {
         raytracer->trace();
     }
     
+    // Coarser meshes make shadow rays cheaper; used when a mesh is added
+    if (ImGui::SliderInt("Shadow LOD", &shadowLod, 0, mesh->getLodCount() - 1)) {
+        raytracer->setShadowLod(shadowLod);
+    }
+    
     // --- SHADOW DEBUG VIEW ---
     static bool showShadowDebug = false;
     if (ImGui::Checkbox("Show Shadow Debug View (Magenta)", &showShadowDebug)) {
@@ -587,6 +773,34 @@ void GUI::renderRayTracingControls(RayTracer* raytracer, Mesh* mesh) {
     }
     // --- END SHADOW DEBUG VIEW ---
     
+    // Cost of each pixel in intersection tests and node visits
+    static bool showHeatmap = false;
+    if (ImGui::Checkbox("Show Cost Heatmap", &showHeatmap)) {
+        raytracer->setHeatmapView(showHeatmap);
+        raytracer->trace();
+    }
+    if (showHeatmap) {
+        ImGui::Text("Blue = cheap, red = %u tests (log scale)", raytracer->getStats().maxPixelCost);
+    }
+    
+    // Counters of the last trace
+    if (ImGui::CollapsingHeader("Statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
+        const RayStats& stats = raytracer->getStats();
+        ImGui::Text("Rays: %.2f M/s", stats.getRaysPerSecond() / 1e6);
+        ImGui::Text("Primary: %llu  Shadow: %llu  Reflection: %llu", (unsigned long long)stats.primaryRays,
+                    (unsigned long long)stats.shadowRays, (unsigned long long)stats.reflectionRays);
+        ImGui::Text("Object tests: %llu spheres, %llu cubes, %llu meshes", (unsigned long long)stats.sphereTests,
+                    (unsigned long long)stats.cubeTests, (unsigned long long)stats.meshTests);
+        ImGui::Text("Triangle tests: %llu", (unsigned long long)stats.triangleTests);
+        ImGui::Text("Cluster node visits: %llu", (unsigned long long)stats.nodeVisits);
+        ImGui::Text("Trace: %.2f ms (threads %.2f ms total, %.2f ms slowest)", stats.traceTime, stats.threadTime,
+                    stats.slowestThreadTime);
+        if (showHeatmap) {
+            ImGui::Text("Heatmap: %.2f ms", stats.heatmapTime);
+        }
+        ImGui::Text("Upload and present: %.2f ms", stats.uploadTime);
+    }
+    
     // Scene objects
     if (ImGui::CollapsingHeader("Scene Objects")) {
         // Add a button to add the current mesh to the scene
@@ -854,4 +1068,122 @@ void GUI::renderRayTracingControls(RayTracer* raytracer, Mesh* mesh) {
     ImGui::Text("- Complex scenes may take longer");
     ImGui::Text("- Higher recursion depth = longer render times");
     ImGui::Text("- Resolution: %dx%d", raytracer->getWidth(), raytracer->getHeight());
-}
\ No newline at end of file
+}
+
+// Draw events[index] as a tree node with the scopes nested inside it as
+// children. Returns the index of the first event after them.
+static size_t renderProfileEvent(const std::vector<ProfileEvent>& events, size_t index) {
+    const ProfileEvent& event = events[index];
+    size_t next = index + 1;
+    auto isChild = [&](size_t i) {
+        return i < events.size() && events[i].thread == event.thread && events[i].depth > event.depth;
+    };
+    
+    ImGuiTreeNodeFlags flags = isChild(next) ? ImGuiTreeNodeFlags_DefaultOpen : ImGuiTreeNodeFlags_Leaf;
+    bool open = ImGui::TreeNodeEx((void*)(intptr_t)index, flags, "%s: %.3f ms", event.name,
+                                  (event.end - event.start) / 1e6);
+    while (isChild(next)) {
+        next = open ? renderProfileEvent(events, next) : next + 1;
+    }
+    if (open) ImGui::TreePop();
+    return next;
+}
+
+void GUI::renderProfilerWindow() {
+    static bool paused = false;
+    static ProfileFrame shownFrame = ProfileFrame();
+    
+    ImGui::Begin("Profiler", &showProfilerWindow);
+    
+    bool enabled = Profiler::isEnabled();
+    if (ImGui::Checkbox("Record", &enabled)) {
+        Profiler::setEnabled(enabled);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused);
+    
+    // Chrome trace capture of the next frames, all threads
+    static int captureFrames = PROFILER_DEFAULT_CAPTURE_FRAMES;
+    static char capturePath[256] = "trace.json";
+    ImGui::SliderInt("Frames", &captureFrames, 1, 600);
+    ImGui::InputText("Trace File", capturePath, sizeof(capturePath));
+    if (Profiler::isCapturing()) {
+        ImGui::Text("%s...", Profiler::getCaptureStatus().c_str());
+    } else {
+        if (ImGui::Button("Capture Trace")) {
+            Profiler::startCapture(captureFrames, capturePath);
+        }
+        if (!Profiler::getCaptureStatus().empty()) {
+            ImGui::SameLine();
+            ImGui::Text("%s", Profiler::getCaptureStatus().c_str());
+        }
+    }
+    ImGui::Separator();
+    
+    // Frame times of the recorded history
+    const std::vector<ProfileFrame>& frames = Profiler::getFrames();
+    if (frames.empty()) {
+        ImGui::Text("No frames recorded");
+        ImGui::End();
+        return;
+    }
+    std::vector<float> frameTimes(frames.size());
+    float total = 0.0f, slowest = 0.0f;
+    for (size_t i = 0; i < frames.size(); i++) {
+        frameTimes[i] = (frames[i].end - frames[i].start) / 1e6f;
+        total += frameTimes[i];
+        slowest = std::max(slowest, frameTimes[i]);
+    }
+    ImGui::Text("Frame: %.2f ms average, %.2f ms slowest over %d frames", total / frames.size(), slowest,
+                (int)frames.size());
+    ImGui::PlotLines("##frametimes", frameTimes.data(), (int)frameTimes.size(), 0, "Frame time (ms)", 0.0f,
+                     std::max(slowest, 1.0f), ImVec2(0, 80));
+    
+    // Scopes of the latest (or paused) frame, nested per thread
+    if (!paused || shownFrame.endEvent == 0) {
+        shownFrame = frames.back();
+    }
+    std::vector<ProfileEvent> events = Profiler::getFrameEvents(shownFrame);
+    
+    // GPU time of the passes that ran lately, beside the CPU time of the
+    // scope with the same name in the shown frame. GPU results arrive a
+    // frame or two late, so they are the latest available, not this frame's.
+    ImGui::Separator();
+    ImGui::Text("GPU passes");
+    int64_t now = Profiler::now();
+    for (const GpuTimer* timer : GpuTimer::getTimers()) {
+        if (timer->getSampleTime() < 0 || now - timer->getSampleTime() > GPU_TIMER_STALE_NS) continue;
+        double cpuMilliseconds = 0.0;
+        for (const ProfileEvent& event : events) {
+            if (event.thread == 0 && std::string(event.name) == timer->getName()) {
+                cpuMilliseconds += (event.end - event.start) / 1e6;
+            }
+        }
+        ImGui::BulletText("%s: GPU %.3f ms, CPU %.3f ms", timer->getName(), timer->getMilliseconds(),
+                          cpuMilliseconds);
+    }
+    
+    ImGui::Separator();
+    ImGui::Text("%.3f ms, %d scopes", (shownFrame.end - shownFrame.start) / 1e6, (int)events.size());
+    size_t index = 0;
+    while (index < events.size()) {
+        if (events[index].thread == 0) {
+            index = renderProfileEvent(events, index);
+            continue;
+        }
+        
+        // Worker threads, collapsed
+        uint32_t thread = events[index].thread;
+        size_t end = index;
+        while (end < events.size() && events[end].thread == thread) end++;
+        ImGui::PushID((int)thread);
+        if (ImGui::TreeNode("thread", "Thread %u (%d scopes)", thread, (int)(end - index))) {
+            while (index < end) index = renderProfileEvent(events, index);
+            ImGui::TreePop();
+        }
+        ImGui::PopID();
+        index = end;
+    }
+    
+    ImGui::End();
+}
@@ -8,6 +8,7 @@
 #include "rasterizer.h"
 #include "scanline.h"
 #include "raytracer.h"
+#include "softrender.h"
 
 enum ViewMode {
     VIEW_3D,
@@ -22,6 +23,7 @@ public:
     // GUI state
     bool showDemoWindow;
     bool showMetricsWindow;
+    bool showProfilerWindow;
     bool showAppMainMenuBar;
     
     // View-specific GUI state
@@ -51,8 +53,21 @@ public:
     int numPolygonVertices = 4;
     float fillColor[3] = {0.0f, 1.0f, 0.0f}; // Green
     
+    // Batch scan conversion parameters
+    int batchPolygonCount = 2000;
+    int batchFillRule = 0; // Index into FillRule
+    
+    // Software 3D rendering parameters
+    bool softwareRendering = false;
+    int softwareShading = 1; // Index into ShadingMode
+    
+    // Instanced grid of the mesh in the 3D view
+    int instanceCount = 100;
+    float instanceSpacing = 1.2f;  // In bounding sphere diameters
+    
     // Ray tracing parameters
     int maxDepth = 3;
+    int shadowLod = 2; // Mesh level of detail for shadow rays
     bool enableShadows = true;
     bool enableReflections = true;
     float spherePosition[3] = {0.0f, 0.0f, 0.0f};
@@ -87,12 +102,13 @@ public:
     void renderScanConversionControls(ScanLineRenderer* scanline, int width, int height);
     void renderRayTracingControls(RayTracer* raytracer, Mesh* mesh);
     void renderMeshLoadingDialog();
+    void renderProfilerWindow();
 
     GUI();
     
     void render(ViewMode* currentView, Mesh* mesh, MeshSlicer* slicer, 
                 Rasterizer* rasterizer, ScanLineRenderer* scanline, 
-                RayTracer* raytracer);
+                RayTracer* raytracer, SoftwareRenderer* softrenderer);
 };
 
 #endif // GUI_H
\ No newline at end of file
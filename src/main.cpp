@@ -6,14 +6,21 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cstdlib>
 
 #include "OFFReader.h"
 #include "mesh.h"
 #include "slicer.h"
 #include "rasterizer.h"
 #include "scanline.h"
+#include "softrender.h"
 #include "raytracer.h"
 #include "gui.h"
+#include "shader_manager.h"
+#include "mesh_arena.h"
+#include "model_cache.h"
+#include "profiler.h"
+#include "benchmark.h"
 
 // Global variables
 GLFWwindow* window;
@@ -24,13 +31,18 @@ std::string model_path = "models/1grm.off";
 ViewMode current_view = VIEW_3D;
 
 // Application state
-OffModel* off_model = nullptr;
 Mesh* mesh = nullptr;
 MeshSlicer* slicer = nullptr;
 Rasterizer* rasterizer = nullptr;
 ScanLineRenderer* scanline = nullptr;
+SoftwareRenderer* softrenderer = nullptr;
 RayTracer* raytracer = nullptr;
 GUI* gui = nullptr;
+FrameUniforms* frame_uniforms = nullptr;
+ShaderManager* shader_manager = nullptr;
+MeshArena* mesh_arena = nullptr;
+ModelCache* model_cache = nullptr;
+Benchmark* benchmark = nullptr;
 
 // Camera state
 float camera_pos[3] = {0.0f, 0.0f, 3.0f}; // Move a bit closer
@@ -51,14 +63,53 @@ bool camera_mouselook_enabled = true;
 
 // Function prototypes
 void init();
+void setupRayTracingScene();
+void updateCameraVectors();
+void applyBenchmarkFrame(const BenchmarkFrame& frame);
 void update();
+void updateFrameUniforms();
 void render();
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void cleanup();
 
-int main() {
+int main(int argc, char** argv) {
+    // Command line: --trace FILE writes a Chrome trace of the first frames,
+    // --benchmark SCRIPT runs a benchmark script and writes its report
+    std::string trace_path;
+    int trace_frames = PROFILER_DEFAULT_CAPTURE_FRAMES;
+    std::string benchmark_path;
+    std::string benchmark_out = "benchmark.json";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--trace-frames" && i + 1 < argc) {
+            trace_frames = std::atoi(argv[++i]);
+        } else if (arg == "--benchmark" && i + 1 < argc) {
+            benchmark_path = argv[++i];
+        } else if (arg == "--benchmark-out" && i + 1 < argc) {
+            benchmark_out = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--trace FILE] [--trace-frames N]"
+                      << " [--benchmark SCRIPT] [--benchmark-out FILE]" << std::endl;
+            return -1;
+        }
+    }
+    
+    // The script picks the model and window size
+    if (!benchmark_path.empty()) {
+        benchmark = new Benchmark();
+        if (!benchmark->load(benchmark_path)) {
+            delete benchmark;
+            return -1;
+        }
+        model_path = benchmark->getModelPath();
+        window_width = benchmark->getWidth();
+        window_height = benchmark->getHeight();
+    }
+    
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -79,6 +130,10 @@ int main() {
     }
     
     glfwMakeContextCurrent(window);
+    if (benchmark) {
+        // Frame times must not be paced by the display
+        glfwSwapInterval(0);
+    }
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     
@@ -97,15 +152,49 @@ int main() {
     
     // Initialize application
     init();
+    if (!trace_path.empty()) {
+        Profiler::startCapture(trace_frames, trace_path);
+    }
+    if (benchmark) {
+        Profiler::setEnabled(true);
+    }
     
     // Main loop
     while (!glfwWindowShouldClose(window)) {
-        processInput(window);
+        Profiler::beginFrame();
+        if (benchmark) {
+            // The script drives every frame; input would make runs differ
+            applyBenchmarkFrame(benchmark->beginFrame());
+        } else {
+            processInput(window);
+        }
         update();
         render();
         
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
+        Profiler::endFrame();
+        
+        if (benchmark) {
+            benchmark->endFrame();
+            if (benchmark->isFinished()) {
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
+    }
+    
+    // The report reads the GL renderer string, so write it before cleanup
+    int result = 0;
+    if (benchmark) {
+        if (!benchmark->isFinished()) {
+            std::cerr << "Benchmark interrupted before the end of " << benchmark_path << std::endl;
+            result = -1;
+        } else if (!benchmark->writeReport(benchmark_out)) {
+            result = -1;
+        }
     }
     
     // Cleanup
@@ -118,26 +207,28 @@ int main() {
     
     // Terminate GLFW
     glfwTerminate();
-    return 0;
+    return result;
 }
 
 void init() {
+    // Create application components
+    shader_manager = new ShaderManager();
+    frame_uniforms = new FrameUniforms();
+    mesh_arena = new MeshArena();
+    model_cache = new ModelCache();
+    
     // Load the mesh
-    off_model = readOffFile(const_cast<char*>(model_path.c_str()));
-    if (!off_model) {
+    CachedModel* model = model_cache->acquire(model_path);
+    if (!model) {
         std::cerr << "Failed to load model: " << model_path << std::endl;
         glfwTerminate();
         exit(-1);
     }
-    
-    // Compute normals
-    computeNormals(off_model);
-    
-    // Create application components
-    mesh = new Mesh(off_model);
-    slicer = new MeshSlicer(mesh);
+    mesh = model->mesh;
+    slicer = model->slicer;
     rasterizer = new Rasterizer(window_width, window_height);
     scanline = new ScanLineRenderer(window_width, window_height);
+    softrenderer = new SoftwareRenderer(window_width, window_height);
     raytracer = new RayTracer(window_width, window_height);
     gui = new GUI();
     
@@ -147,6 +238,35 @@ void init() {
     glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
     
     // Initialize camera vectors based on initial rotation
+    updateCameraVectors();
+    
+    // Start with UI mode enabled instead of camera mode
+    camera_mouselook_enabled = false;
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+}
+
+// Ray trace the current mesh, lit by the GUI light if there is no light yet
+void setupRayTracingScene() {
+    Material meshMaterial;
+    meshMaterial.color = glm::vec3(0.7f, 0.7f, 0.7f);
+    meshMaterial.reflectivity = 0.2f;
+    
+    raytracer->clearScene();
+    raytracer->addMesh(glm::vec3(0.0f), mesh, meshMaterial);
+    
+    // Make sure we have a light
+    if (raytracer->getLights().empty()) {
+        Light light(
+            glm::vec3(gui->lightPosition[0], gui->lightPosition[1], gui->lightPosition[2]),
+            glm::vec3(gui->lightColor[0], gui->lightColor[1], gui->lightColor[2]),
+            gui->lightIntensity
+        );
+        raytracer->addLight(light);
+    }
+}
+
+// Front, right and up vectors from the yaw and pitch in camera_rot
+void updateCameraVectors() {
     glm::vec3 front;
     front.x = cos(glm::radians(camera_rot[1])) * cos(glm::radians(camera_rot[0]));
     front.y = sin(glm::radians(camera_rot[0]));
@@ -154,65 +274,78 @@ void init() {
     camera_front = glm::normalize(front);
     camera_right = glm::normalize(glm::cross(camera_front, world_up));
     camera_up = glm::normalize(glm::cross(camera_right, camera_front));
+}
+
+// Put the application in the state the benchmark script gives this frame
+void applyBenchmarkFrame(const BenchmarkFrame& frame) {
+    const BenchmarkRun& run = *frame.run;
+    if (frame.firstOfRun) {
+        current_view = run.view;
+        gui->softwareRendering = run.softwareRendering;
+        mesh->setForcedLod(std::min(run.forcedLod, mesh->getLodCount() - 1));
+        
+        raytracer->setMaxDepth(run.rayTrace.maxDepth);
+        raytracer->setEnableShadows(run.rayTrace.shadows);
+        raytracer->setEnableReflections(run.rayTrace.reflections);
+        raytracer->setShadowLod(run.rayTrace.shadowLod);
+        if (run.view == VIEW_RAYTRACE) {
+            // The shadow level of detail applies when the mesh is added
+            setupRayTracingScene();
+        }
+    }
     
-    // Start with UI mode enabled instead of camera mode
-    camera_mouselook_enabled = false;
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    if (frame.moveCamera) {
+        camera_pos[0] = frame.camera.position.x;
+        camera_pos[1] = frame.camera.position.y;
+        camera_pos[2] = frame.camera.position.z;
+        camera_rot[0] = frame.camera.pitch;
+        camera_rot[1] = frame.camera.yaw;
+        updateCameraVectors();
+    }
+    
+    if (run.sweepSlice) {
+        Plane plane(run.sliceNormal, frame.sliceDistance);
+        if (slicer->getPlaneCount() == 0) {
+            slicer->addPlane(plane);
+        } else {
+            slicer->updatePlane(0, plane);
+        }
+    }
 }
 
 void update() {
+    PROFILE_SCOPE("update");
+    
     // Check if we need to load a new mesh
     if (gui->loadMeshRequested) {
         // Load the new mesh
         if (!gui->meshPathToLoad.empty()) {
-            // Clean up old model
-            if (mesh) delete mesh;
-            if (slicer) delete slicer;
-            if (off_model) FreeOffModel(off_model);
+            // Switch to the model, loading it unless it is still resident.
+            // The current one stays in the cache for switching back.
+            CachedModel* model = model_cache->acquire(gui->meshPathToLoad);
             
-            // Load new model
-            model_path = gui->meshPathToLoad;
-            off_model = readOffFile(const_cast<char*>(model_path.c_str()));
-            
-            if (off_model) {
-                // Compute normals
-                computeNormals(off_model);
-                
-                // Create new mesh and slicer
-                mesh = new Mesh(off_model);
-                slicer = new MeshSlicer(mesh);
+            if (model) {
+                model_path = gui->meshPathToLoad;
+                mesh = model->mesh;
+                slicer = model->slicer;
                 
                 // Update mesh for ray tracing if in that view
                 if (current_view == VIEW_RAYTRACE) {
                     // Clear existing scene and add the mesh
-                    Material meshMaterial;
-                    meshMaterial.color = glm::vec3(0.7f, 0.7f, 0.7f);
-                    meshMaterial.reflectivity = 0.2f;
-                    
-                    raytracer->clearScene();
-                    raytracer->addMesh(glm::vec3(0.0f), mesh, meshMaterial);
-                    
-                    // Make sure we have a light
-                    if (raytracer->getLights().empty()) {
-                        Light light(
-                            glm::vec3(gui->lightPosition[0], gui->lightPosition[1], gui->lightPosition[2]),
-                            glm::vec3(gui->lightColor[0], gui->lightColor[1], gui->lightColor[2]),
-                            gui->lightIntensity
-                        );
-                        raytracer->addLight(light);
-                    }
+                    setupRayTracingScene();
                     
                     // Force an update
                     raytracer->trace();
                 }
             } else {
-                std::cerr << "Failed to load model: " << model_path << std::endl;
+                std::cerr << "Failed to load model: " << gui->meshPathToLoad << std::endl;
             }
         }
         
         // Reset the flag
         gui->loadMeshRequested = false;
     }
+    model_cache->update();
     
     // Update based on current view
     switch (current_view) {
@@ -248,7 +381,21 @@ void update() {
     }
 }
 
+void updateFrameUniforms() {
+    glm::vec3 viewPos(camera_pos[0], camera_pos[1], camera_pos[2]);
+    
+    FrameConstants frame;
+    frame.view = glm::lookAt(viewPos, viewPos + camera_front, camera_up);
+    frame.projection = glm::perspective(glm::radians(45.0f),
+                                        (float)window_width / (float)window_height, 0.1f, 100.0f);
+    frame.viewPos = glm::vec4(viewPos, 1.0f);
+    frame.lightPos = glm::vec4(5.0f, 5.0f, 5.0f, 1.0f);
+    frame.lightColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    frame_uniforms->update(frame);
+}
+
 void render() {
+    PROFILE_SCOPE("render");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     // Start ImGui frame
@@ -256,10 +403,17 @@ void render() {
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
     
+    // Camera and light for every program that draws this frame
+    updateFrameUniforms();
+    
     // Render based on current view
     switch (current_view) {
         case VIEW_3D:
-            mesh->render();
+            if (gui->softwareRendering) {
+                softrenderer->render(mesh);
+            } else {
+                mesh->render();
+            }
             break;
             
         case VIEW_SLICE:
@@ -280,14 +434,20 @@ void render() {
     }
     
     // Render GUI
-    gui->render(&current_view, mesh, slicer, rasterizer, scanline, raytracer);
+    {
+        PROFILE_SCOPE("GUI::render");
+        gui->render(&current_view, mesh, slicer, rasterizer, scanline, raytracer, softrenderer);
+    }
     
     // Render ImGui
+    PROFILE_SCOPE("ImGui::Render");
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void processInput(GLFWwindow* window) {
+    PROFILE_SCOPE("processInput");
+    
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
     
@@ -399,15 +559,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
         camera_rot[0] = -89.0f;
     
     // Update front, right and up vectors using the updated Euler angles
-    glm::vec3 front;
-    front.x = cos(glm::radians(camera_rot[1])) * cos(glm::radians(camera_rot[0]));
-    front.y = sin(glm::radians(camera_rot[0]));
-    front.z = sin(glm::radians(camera_rot[1])) * cos(glm::radians(camera_rot[0]));
-    camera_front = glm::normalize(front);
-    
-    // Also re-calculate the Right and Up vector
-    camera_right = glm::normalize(glm::cross(camera_front, world_up));
-    camera_up = glm::normalize(glm::cross(camera_right, camera_front));
+    updateCameraVectors();
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
@@ -418,6 +570,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     // Update components with new sizes
     if (rasterizer) rasterizer->resize(width, height);
     if (scanline) scanline->resize(width, height);
+    if (softrenderer) softrenderer->resize(width, height);
     if (raytracer) raytracer->resize(width, height);
 }
 
@@ -425,9 +578,12 @@ void cleanup() {
     // Clean up resources
     if (gui) delete gui;
     if (raytracer) delete raytracer;
+    if (softrenderer) delete softrenderer;
     if (scanline) delete scanline;
     if (rasterizer) delete rasterizer;
-    if (slicer) delete slicer;
-    if (mesh) delete mesh;
-    if (off_model) FreeOffModel(off_model);
+    if (model_cache) delete model_cache;
+    if (benchmark) delete benchmark;
+    if (mesh_arena) delete mesh_arena;
+    if (frame_uniforms) delete frame_uniforms;
+    if (shader_manager) delete shader_manager;
 }
\ No newline at end of file
@@ -1,38 +1,39 @@
 #include "mesh.h"
+#include "mesh_arena.h"
+#include "profiler.h"
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <thread>
+#include <cmath>
+#include <cstddef>
 
 // External variables from main.cpp
-extern float camera_pos[3];
-extern glm::vec3 camera_front;
-extern glm::vec3 camera_up;
-extern int window_width;
 extern int window_height;
+extern FrameUniforms* frame_uniforms;
+extern ShaderManager* shader_manager;
+extern MeshArena* mesh_arena;
 
 // Shader source paths
 const char* vertexShaderPath = "shaders/basic.vert";
 const char* fragmentShaderPath = "shaders/basic.frag";
+const char* packedVertexShaderPath = "shaders/basic_packed.vert";
+const char* instanceCullShaderPath = "shaders/instance_cull.comp";
 
-// Utility function to read shader source
-std::string readFile(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        std::cerr << "Could not open file: " << filePath << std::endl;
-        return "";
-    }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
+// local_size_x of shaders/instance_cull.comp, which also caps the number of
+// levels it can choose from
+const int INSTANCE_CULL_GROUP_SIZE = 64;
+static_assert(MESH_LOD_COUNT <= 8, "instance_cull.comp supports at most 8 levels of detail");
 
-Mesh::Mesh(OffModel* model) {
+Mesh::Mesh(const OffModel* model) {
     // Initialize transform
     position = glm::vec3(0.0f);
     rotation = glm::vec3(0.0f);
     scale = glm::vec3(1.0f);
+    compactVertices = true;
+    clusterCulling = true;
+    forcedLod = -1;
+    currentLod = 0;
+    instancing = false;
     
     // Calculate bounding box
     glm::vec3 min_bounds(std::numeric_limits<float>::max());
@@ -86,6 +87,11 @@ Mesh::Mesh(OffModel* model) {
     }
     
     // Process polygons - convert to triangles if necessary
+    size_t indexCount = 0;
+    for (int i = 0; i < model->numberOfPolygons; i++) {
+        indexCount += 3 * std::max(0, model->polygons[i].noSides - 2);
+    }
+    indices.reserve(indexCount);
     for (int i = 0; i < model->numberOfPolygons; i++) {
         if (model->polygons[i].noSides >= 3) {
             // Triangulate polygon if it has more than 3 sides
@@ -94,25 +100,67 @@ Mesh::Mesh(OffModel* model) {
                 indices.push_back(model->polygons[i].v[0]);
                 indices.push_back(model->polygons[i].v[j + 1]);
                 indices.push_back(model->polygons[i].v[j + 2]);
-                
-                // Create triangle for ray tracing and slicing
-                Triangle tri;
-                tri.v0 = vertices[model->polygons[i].v[0]];
-                tri.v1 = vertices[model->polygons[i].v[j + 1]];
-                tri.v2 = vertices[model->polygons[i].v[j + 2]];
-                
-                // Calculate triangle normal and centroid
-                glm::vec3 edge1 = tri.v1.position - tri.v0.position;
-                glm::vec3 edge2 = tri.v2.position - tri.v0.position;
-                tri.normal = glm::normalize(glm::cross(edge1, edge2));
-                
-                tri.centroid = (tri.v0.position + tri.v1.position + tri.v2.position) / 3.0f;
-                
-                triangles.push_back(tri);
             }
         }
     }
     
+    // Reorder triangles for the post-transform vertex cache, then vertices
+    // in order of first use, once per load
+    cacheStatsBefore = analyzeVertexCache(indices, vertices.size());
+    optimizeVertexCache(indices, vertices.size());
+    remapVertices(vertices, optimizeVertexFetch(indices, vertices.size()));
+    
+    // Simplify into coarser levels of detail, each appended to the index
+    // buffer and cache-optimized on its own. Stops early once the
+    // simplifier cannot remove any more triangles.
+    lods.push_back({0, static_cast<unsigned int>(indices.size()), 0.0f, 0, 0});
+    std::vector<glm::vec3> positions(vertices.size());
+    boundingRadius = 0.0f;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[i] = vertices[i].position;
+        boundingRadius = std::max(boundingRadius, glm::length(positions[i]));
+    }
+    MeshSimplifier simplifier(positions, indices);
+    for (int level = 1; level < MESH_LOD_COUNT; level++) {
+        simplifier.simplify(lods[0].indexCount >> level);
+        std::vector<unsigned int> lodIndices = simplifier.getIndices();
+        if (lodIndices.empty() || lodIndices.size() >= lods.back().indexCount) {
+            break;
+        }
+        optimizeVertexCache(lodIndices, vertices.size());
+        lods.push_back({static_cast<unsigned int>(indices.size()), static_cast<unsigned int>(lodIndices.size()),
+                        simplifier.getError(), 0, 0});
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+    }
+    
+    // Split every level into clusters for culling and as a coarse
+    // acceleration structure for the slicer and ray tracer. Levels own
+    // disjoint index ranges, so they are clustered on separate threads.
+    std::vector<std::vector<MeshCluster>> lodClusters(lods.size());
+    std::vector<std::thread> threads;
+    for (size_t level = 0; level < lods.size(); level++) {
+        threads.emplace_back([&, level]() {
+            buildClusters(positions, indices, lods[level].indexOffset, lods[level].indexCount, lodClusters[level]);
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (size_t level = 0; level < lods.size(); level++) {
+        lods[level].clusterOffset = static_cast<unsigned int>(clusters.size());
+        lods[level].clusterCount = static_cast<unsigned int>(lodClusters[level].size());
+        clusters.insert(clusters.end(), lodClusters[level].begin(), lodClusters[level].end());
+    }
+    
+    // Cache efficiency of the final order of the full mesh
+    cacheStatsAfter = analyzeVertexCache(std::vector<unsigned int>(indices.begin(), indices.begin() + lods[0].indexCount),
+                                         vertices.size());
+    
+    // Appending the levels of detail leaves slack in the index buffer
+    indices.shrink_to_fit();
+    clusters.shrink_to_fit();
+    
+    // Bounding box the compact vertex layout quantizes positions to
+    positionQuantization = VertexPacking::computePositionQuantization(vertices.begin(), vertices.end());
+    
     // Setup OpenGL objects
     setupMesh();
     setupShaders();
@@ -122,95 +170,106 @@ Mesh::Mesh(OffModel* model) {
 }
 
 Mesh::~Mesh() {
-    // Cleanup OpenGL objects
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(shaderProgram);
+    // Return the ranges to the arena and cleanup OpenGL objects
+    mesh_arena->freeVertices(vertexRange);
+    mesh_arena->freeIndices(indexRange);
+    glDeleteBuffers(1, &indirectBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &visibleInstanceBuffer);
+    glDeleteBuffers(1, &instanceCommandBuffer);
 }
 
 void Mesh::setupMesh() {
-    // Create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &indirectBuffer);
     
-    glBindVertexArray(VAO);
+    // Indices go into the arena as they are: they stay relative to the
+    // mesh's own vertices, and draws add the range offsets
+    indexRange = mesh_arena->allocateIndices(indices.size());
+    mesh_arena->uploadIndices(indexRange, indices.data(), indices.size());
     
-    // Load vertices into VBO
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), &vertices[0], GL_STATIC_DRAW);
+    setupInstancing();
     
-    // Load indices into EBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-    
-    // Set vertex attribute pointers
-    // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)0);
-    
-    // Normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
-    
-    // Color
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, color));
+    // Load vertices into the arena in the current layout
+    vertexRange = -1;
+    uploadVertices();
+}
+
+void Mesh::setupInstancing() {
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &visibleInstanceBuffer);
+    glGenBuffers(1, &instanceCommandBuffer);
     
-    glBindVertexArray(0);
+    // One draw command per level of detail
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, instanceCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, MESH_LOD_COUNT * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
 
-void Mesh::setupShaders() {
-    // Read shader sources
-    std::string vertexShaderSource = readFile(vertexShaderPath);
-    std::string fragmentShaderSource = readFile(fragmentShaderPath);
-    
-    const char* vShaderCode = vertexShaderSource.c_str();
-    const char* fShaderCode = fragmentShaderSource.c_str();
-    
-    // Compile shaders
-    GLuint vertex, fragment;
-    int success;
-    char infoLog[512];
-    
-    // Vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+// (Re)allocate the vertex range for the current layout and fill it. The
+// layouts differ in size and alignment, so switching takes a new range.
+void Mesh::uploadVertices() {
+    if (vertexRange >= 0) {
+        mesh_arena->freeVertices(vertexRange);
     }
-    
-    // Fragment shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+    vertexRange = mesh_arena->allocateVertices(vertices.size(), getVertexSize());
+    updateVertexBuffer();
+}
+
+size_t Mesh::getGpuBytes() const {
+    size_t bytes = getVertexBufferBytes() + indices.size() * sizeof(unsigned int);
+    bytes += MESH_LOD_COUNT * sizeof(DrawElementsIndirectCommand);
+    bytes += instances.size() * sizeof(MeshInstance) * (1 + lods.size());
+    return bytes;
+}
+
+void Mesh::setCompactVertices(bool compact) {
+    if (compact == compactVertices) {
+        return;
+    }
+    compactVertices = compact;
+    uploadVertices();
+}
+
+void Mesh::setupShaders() {
+    // Compiled once per process, not once per loaded model
+    shaderProgram = shader_manager->getProgram(vertexShaderPath, fragmentShaderPath);
+    packedShaderProgram = shader_manager->getProgram(packedVertexShaderPath, fragmentShaderPath);
+    instanceCullProgram = shader_manager->getComputeProgram(instanceCullShaderPath);
+}
+
+void Mesh::setInstances(const std::vector<MeshInstance>& newInstances) {
+    instances.assign(newInstances.begin(),
+                     newInstances.begin() + std::min(static_cast<int>(newInstances.size()), MESH_MAX_INSTANCES));
+    if (instances.empty()) {
+        return;
     }
     
-    // Shader program
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertex);
-    glAttachShader(shaderProgram, fragment);
-    glLinkProgram(shaderProgram);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(MeshInstance), instances.data(), GL_STATIC_DRAW);
     
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    // Room for every instance in every level's range, since in the worst
+    // case all of them pick the same level
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleInstanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, lods.size() * instances.size() * sizeof(MeshInstance), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+std::vector<MeshInstance> Mesh::makeInstanceGrid(int count, float spacing) {
+    std::vector<MeshInstance> grid(std::max(0, std::min(count, MESH_MAX_INSTANCES)));
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(grid.size()))));
+    for (size_t i = 0; i < grid.size(); i++) {
+        float x = (static_cast<int>(i) % side - (side - 1) * 0.5f) * spacing;
+        float z = (static_cast<int>(i) / side - (side - 1) * 0.5f) * spacing;
+        grid[i].transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+        
+        // Light tints spread around the hue circle by the golden ratio, so
+        // neighbors differ but the vertex colors still show through
+        float hue = std::fmod(i * 0.618034f, 1.0f) * 6.0f;
+        glm::vec3 tint = glm::clamp(glm::vec3(std::abs(hue - 3.0f) - 1.0f, 2.0f - std::abs(hue - 2.0f),
+                                              2.0f - std::abs(hue - 4.0f)), 0.0f, 1.0f);
+        grid[i].color = glm::vec4(glm::mix(glm::vec3(1.0f), tint, 0.4f), 1.0f);
     }
-    
-    // Delete the shaders after linking
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    return grid;
 }
 
 void Mesh::updateModelMatrix() {
@@ -223,10 +282,74 @@ void Mesh::updateModelMatrix() {
 }
 
 void Mesh::updateVertexBuffer() {
-    // Update only the VBO with the modified vertices
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), &vertices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Update only the vertex range with the modified vertices
+    if (compactVertices) {
+        std::vector<PackedMeshVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            packed[i] = VertexPacking::packVertex(vertices[i].position, vertices[i].normal, vertices[i].color,
+                                                  positionQuantization);
+        }
+        mesh_arena->uploadVertices(vertexRange, packed.data(), packed.size() * sizeof(PackedMeshVertex));
+    } else {
+        mesh_arena->uploadVertices(vertexRange, vertices.data(), vertices.size() * sizeof(MeshVertex));
+    }
+}
+
+std::vector<Triangle> Mesh::buildTriangles(unsigned int indexOffset, unsigned int indexCount) const {
+    std::vector<Triangle> result(indexCount / 3);
+    for (size_t t = 0; t < result.size(); t++) {
+        const unsigned int* tri = &indices[indexOffset + t * 3];
+        Triangle& triangle = result[t];
+        triangle.v0 = vertices[tri[0]];
+        triangle.v1 = vertices[tri[1]];
+        triangle.v2 = vertices[tri[2]];
+        
+        // Calculate triangle normal and centroid
+        glm::vec3 edge1 = triangle.v1.position - triangle.v0.position;
+        glm::vec3 edge2 = triangle.v2.position - triangle.v0.position;
+        triangle.normal = glm::normalize(glm::cross(edge1, edge2));
+        triangle.centroid = (triangle.v0.position + triangle.v1.position + triangle.v2.position) / 3.0f;
+    }
+    return result;
+}
+
+std::vector<Triangle> Mesh::getLodTriangles(int level) const {
+    const MeshLod& lod = lods[std::max(0, std::min(level, getLodCount() - 1))];
+    return buildTriangles(lod.indexOffset, lod.indexCount);
+}
+
+std::vector<MeshCluster> Mesh::getLodClusters(int level) const {
+    const MeshLod& lod = lods[std::max(0, std::min(level, getLodCount() - 1))];
+    std::vector<MeshCluster> result(clusters.begin() + lod.clusterOffset,
+                                    clusters.begin() + lod.clusterOffset + lod.clusterCount);
+    for (MeshCluster& cluster : result) {
+        cluster.indexOffset -= lod.indexOffset;
+    }
+    return result;
+}
+
+int Mesh::selectLod(const glm::vec3& viewPos, float viewportHeight, float fovY) const {
+    if (forcedLod >= 0) {
+        return std::min(forcedLod, getLodCount() - 1);
+    }
+    
+    // Distance to the nearest point of the bounding sphere; the model is
+    // centered on its origin before the transform
+    float maxScale = std::max(std::max(std::abs(scale.x), std::abs(scale.y)), std::abs(scale.z));
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    float distance = glm::length(viewPos - center) - boundingRadius * maxScale;
+    if (distance <= 0.0f) {
+        return 0;
+    }
+    
+    // Screen pixels covered by one world unit at that distance
+    float pixelsPerUnit = viewportHeight / (2.0f * distance * std::tan(fovY * 0.5f));
+    int level = 0;
+    while (level + 1 < getLodCount() &&
+           lods[level + 1].error * maxScale * pixelsPerUnit <= MESH_LOD_MAX_PIXEL_ERROR) {
+        level++;
+    }
+    return level;
 }
 
 void Mesh::update() {
@@ -234,36 +357,134 @@ void Mesh::update() {
 }
 
 void Mesh::render() {
-    // Use shader program
-    glUseProgram(shaderProgram);
-    
-    // Set uniforms
-    glm::mat4 view = glm::lookAt(
-        glm::vec3(camera_pos[0], camera_pos[1], camera_pos[2]),
-        glm::vec3(camera_pos[0], camera_pos[1], camera_pos[2]) + camera_front,
-        camera_up
-    );
-    
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 
-                                           (float)window_width/(float)window_height, 0.1f, 100.0f);
-    
-    // Set matrices
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    
-    // Set basic lighting parameters (assuming shader supports these)
-    glm::vec3 lightPos(5.0f, 5.0f, 5.0f);
-    glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, glm::value_ptr(lightPos));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, glm::value_ptr(lightColor));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(glm::vec3(camera_pos[0], camera_pos[1], camera_pos[2])));
-    
-    // Draw the mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    PROFILE_SCOPE("Mesh::render");
+    GpuTimerScope gpuScope(renderTimer);
+    
+    if (instancing && !instances.empty()) {
+        renderInstances();
+        return;
+    }
+    
+    // Camera and light come from the per-frame uniform buffer
+    const ShaderProgram* program = compactVertices ? packedShaderProgram : shaderProgram;
+    program->use();
+    
+    // Bounding box mapping of the compact layout. The program is shared, so
+    // this is per mesh state and set at draw time.
+    if (compactVertices) {
+        program->setVec3("positionCenter", positionQuantization.center);
+        program->setVec3("positionHalfExtent", positionQuantization.halfExtent);
+    }
+    
+    // A single copy: the instance attributes are disabled in the VAO, so the
+    // shader reads these constant values for the model matrix and tint
+    for (int column = 0; column < 4; column++) {
+        glVertexAttrib4fv(3 + column, glm::value_ptr(modelMatrix[column]));
+    }
+    glVertexAttrib4f(7, 1.0f, 1.0f, 1.0f, 1.0f);
+    
+    // Draw the level of detail for the current view
+    const FrameConstants& frame = frame_uniforms->getConstants();
+    glm::vec3 viewPos = frame_uniforms->getViewPos();
+    currentLod = selectLod(viewPos, (float)window_height);
+    const MeshLod& lod = lods[currentLod];
+    
+    // The arena may have moved the ranges since the last frame
+    GLint baseVertex = mesh_arena->getBaseVertex(vertexRange, getVertexSize());
+    GLuint firstIndex = mesh_arena->getFirstIndex(indexRange);
+    mesh_arena->bindVertexArray(compactVertices);
+    if (clusterCulling) {
+        // Only the clusters in the frustum and facing the camera, as one
+        // multi-draw. Back-facing clusters are safe to drop because
+        // GL_CULL_FACE would discard their triangles anyway, unless the
+        // transform mirrors the mesh.
+        glm::vec3 modelEye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(viewPos, 1.0f));
+        bool mirrored = glm::determinant(glm::mat3(modelMatrix)) < 0.0f;
+        cullStats = cullClusters(clusters.data() + lod.clusterOffset, lod.clusterCount,
+                                 frame.projection * frame.view * modelMatrix,
+                                 modelEye, !mirrored, drawCommands);
+        PROFILE_COUNTER("triangles drawn", cullStats.triangles);
+        for (DrawElementsIndirectCommand& command : drawCommands) {
+            command.firstIndex += firstIndex;
+            command.baseVertex = baseVertex;
+        }
+        if (!drawCommands.empty()) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCommands.size() * sizeof(DrawElementsIndirectCommand),
+                         drawCommands.data(), GL_STREAM_DRAW);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(drawCommands.size()), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    } else {
+        cullStats = ClusterCullStats();
+        PROFILE_COUNTER("triangles drawn", lod.indexCount / 3);
+        glDrawElementsBaseVertex(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                                 (void*)((firstIndex + lod.indexOffset) * sizeof(unsigned int)), baseVertex);
+    }
+    glBindVertexArray(0);
+    
+    // Reset state
+    glUseProgram(0);
+}
+
+void Mesh::renderInstances() {
+    PROFILE_SCOPE("Mesh::renderInstances");
+    GpuTimerScope gpuScope(instanceTimer);
+    
+    const FrameConstants& frame = frame_uniforms->getConstants();
+    const int lodCount = getLodCount();
+    const int instanceCount = getInstanceCount();
+    
+    // Every level draws its whole index range for as many instances as the
+    // culling pass counts, taken from its own range of the visible buffer
+    GLint baseVertex = mesh_arena->getBaseVertex(vertexRange, getVertexSize());
+    GLuint firstIndex = mesh_arena->getFirstIndex(indexRange);
+    DrawElementsIndirectCommand commands[MESH_LOD_COUNT];
+    for (int level = 0; level < lodCount; level++) {
+        commands[level] = { lods[level].indexCount, 0, firstIndex + lods[level].indexOffset, baseVertex,
+                            static_cast<unsigned int>(level * instanceCount) };
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, instanceCommandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, lodCount * sizeof(DrawElementsIndirectCommand), commands);
+    
+    // Cull the instances and pick their levels on the GPU, with the same
+    // rule as selectLod
+    glm::vec4 planes[6];
+    extractFrustumPlanes(frame.projection * frame.view, planes);
+    float lodErrors[MESH_LOD_COUNT];
+    for (int level = 0; level < lodCount; level++) {
+        lodErrors[level] = lods[level].error;
+    }
+    instanceCullProgram->use();
+    instanceCullProgram->setMat4("model", modelMatrix);
+    instanceCullProgram->setInt("instanceCount", instanceCount);
+    instanceCullProgram->setVec4Array("frustumPlanes", planes, 6);
+    instanceCullProgram->setFloat("boundingRadius", boundingRadius);
+    instanceCullProgram->setInt("lodCount", lodCount);
+    instanceCullProgram->setFloatArray("lodErrors", lodErrors, lodCount);
+    instanceCullProgram->setInt("forcedLod", forcedLod);
+    instanceCullProgram->setFloat("pixelsPerUnitAtUnitDistance",
+                                  (float)window_height / (2.0f * std::tan(glm::radians(45.0f) * 0.5f)));
+    instanceCullProgram->setFloat("maxPixelError", MESH_LOD_MAX_PIXEL_ERROR);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleInstanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, instanceCommandBuffer);
+    glDispatchCompute((instanceCount + INSTANCE_CULL_GROUP_SIZE - 1) / INSTANCE_CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    
+    // Draw all visible instances of all levels
+    const ShaderProgram* program = compactVertices ? packedShaderProgram : shaderProgram;
+    program->use();
+    if (compactVertices) {
+        program->setVec3("positionCenter", positionQuantization.center);
+        program->setVec3("positionHalfExtent", positionQuantization.halfExtent);
+    }
+    mesh_arena->bindVertexArray(compactVertices, visibleInstanceBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, lodCount, 0);
     glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
     
     // Reset state
+    cullStats = ClusterCullStats();
     glUseProgram(0);
-}
\ No newline at end of file
+}
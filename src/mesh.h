@@ -6,6 +6,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 #include "OFFReader.h"
+#include "mesh_clusters.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "gpu_timer.h"
+#include "shader_manager.h"
+#include "vertex_packing.h"
 
 // Create a separate vertex structure for the mesh
 struct MeshVertex {
@@ -21,15 +27,79 @@ struct Triangle {
     glm::vec3 normal;
 };
 
+// Levels of detail generated at load: LOD 0 is the full mesh and every
+// further level has about half the triangles of the previous one
+const int MESH_LOD_COUNT = 5;
+
+// Auto LOD selection takes the coarsest level whose simplification error
+// projects to at most this many pixels on screen
+const float MESH_LOD_MAX_PIXEL_ERROR = 1.0f;
+
+// One level of detail: a range of the shared index buffer, the clusters it
+// is split into, and the largest distance (in normalized model units) it
+// deviates from the full mesh
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+    unsigned int clusterOffset;
+    unsigned int clusterCount;
+};
+
+// One copy of the mesh in instanced mode, placed by transform (applied
+// after the mesh's own transform) and tinted by color
+struct MeshInstance {
+    glm::mat4 transform;
+    glm::vec4 color;
+};
+
+// Most instances setInstances() accepts
+const int MESH_MAX_INSTANCES = 16384;
+
 class Mesh {
 private:
-    // OpenGL objects
-    GLuint VAO, VBO, EBO;
+    // Vertex and index ranges in the shared MeshArena; their offsets
+    // become the baseVertex and firstIndex of every draw
+    int vertexRange, indexRange;
+    GLuint indirectBuffer;
     
-    // Mesh data
+    // Mesh data: the only CPU copy of the geometry. The OffModel it was
+    // built from can be freed after construction, and Triangle lists are
+    // built on request by whoever needs them.
     std::vector<MeshVertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Triangle> triangles;
+    
+    // Levels of detail; their triangles are stored back to back in indices
+    // and all of them index the same vertices
+    std::vector<MeshLod> lods;
+    int forcedLod;      // -1 selects by projected size
+    int currentLod;     // Level drawn by the last render()
+    float boundingRadius;
+    
+    // Clusters of every level, in index buffer order, and the draw list
+    // the last render() culled them to
+    std::vector<MeshCluster> clusters;
+    bool clusterCulling;
+    std::vector<DrawElementsIndirectCommand> drawCommands;
+    ClusterCullStats cullStats;
+    
+    // Instanced mode: the mesh drawn once per instance in one multi-draw.
+    // A compute shader culls the instances and picks each one's level of
+    // detail, writing the survivors grouped by level into the visible
+    // buffer and their counts into one draw command per level.
+    GLuint instanceBuffer, visibleInstanceBuffer, instanceCommandBuffer;
+    std::vector<MeshInstance> instances;
+    bool instancing;
+    ShaderProgram* instanceCullProgram;
+    
+    // GPU time of the single and the instanced draw
+    GpuTimer renderTimer{"Mesh::render"};
+    GpuTimer instanceTimer{"Mesh::renderInstances"};
+    
+    // Post-transform cache efficiency of the indices in OFF face order and
+    // after the load-time reordering
+    VertexCacheStats cacheStatsBefore;
+    VertexCacheStats cacheStatsAfter;
     
     // Transform
     glm::vec3 position;
@@ -39,21 +109,41 @@ private:
     // Matrix
     glm::mat4 modelMatrix;
     
-    // Shader
-    GLuint shaderProgram;
+    // Shader, and the variant reading the compact vertex layout; owned and
+    // shared by the ShaderManager
+    ShaderProgram* shaderProgram;
+    ShaderProgram* packedShaderProgram;
+    
+    // GPU vertex layout: MeshVertex floats, or PackedMeshVertex quantized
+    // to the bounding box of the positions
+    bool compactVertices;
+    PositionQuantization positionQuantization;
     
     // Setup methods
     void setupMesh();
     void setupShaders();
+    void uploadVertices();
+    size_t getVertexSize() const { return compactVertices ? sizeof(PackedMeshVertex) : sizeof(MeshVertex); }
+    void setupInstancing();
+    void renderInstances();
+    std::vector<Triangle> buildTriangles(unsigned int indexOffset, unsigned int indexCount) const;
     
 public:
-    Mesh(OffModel* model);
+    Mesh(const OffModel* model);
     ~Mesh();
     
     // Getters
     const std::vector<MeshVertex>& getVertices() const { return vertices; }
-    const std::vector<unsigned int>& getIndices() const { return indices; }
-    const std::vector<Triangle>& getTriangles() const { return triangles; }
+    const std::vector<unsigned int>& getIndices() const { return indices; }   // All levels, see getLod()
+    // Triangles of a level in index order, built on each call
+    std::vector<Triangle> getTriangles() const { return getLodTriangles(0); }
+    std::vector<Triangle> getLodTriangles(int level) const;
+    const std::vector<MeshCluster>& getClusters() const { return clusters; }
+    // Clusters of one level with index ranges relative to the level, i.e.
+    // to the triangles of getLodTriangles(level) times three
+    std::vector<MeshCluster> getLodClusters(int level) const;
+    const VertexCacheStats& getCacheStatsBefore() const { return cacheStatsBefore; }
+    const VertexCacheStats& getCacheStatsAfter() const { return cacheStatsAfter; }
     
     // Editable vertices
     std::vector<MeshVertex>& getEditableVertices() { return vertices; }
@@ -71,12 +161,50 @@ public:
     void updateModelMatrix();
     glm::mat4 getModelMatrix() const { return modelMatrix; }
     
+    // Levels of detail
+    int getLodCount() const { return static_cast<int>(lods.size()); }
+    const MeshLod& getLod(int level) const { return lods[level]; }
+    void setForcedLod(int level) { forcedLod = level; }
+    int getForcedLod() const { return forcedLod; }
+    int getCurrentLod() const { return currentLod; }
+    float getBoundingRadius() const { return boundingRadius; }   // Around the model space origin
+    
+    // Coarsest level whose error covers at most MESH_LOD_MAX_PIXEL_ERROR
+    // pixels when seen from viewPos with a vertical field of view of fovY,
+    // or the forced level
+    int selectLod(const glm::vec3& viewPos, float viewportHeight, float fovY = glm::radians(45.0f)) const;
+    
+    // Per-frame frustum and back-face culling of clusters before drawing
+    void setClusterCulling(bool enable) { clusterCulling = enable; }
+    bool getClusterCulling() const { return clusterCulling; }
+    const ClusterCullStats& getCullStats() const { return cullStats; }
+    
+    // Instanced mode: draw one copy of the mesh per instance instead of the
+    // mesh itself. Cluster culling does not apply to instances.
+    void setInstances(const std::vector<MeshInstance>& newInstances);
+    const std::vector<MeshInstance>& getInstances() const { return instances; }
+    int getInstanceCount() const { return static_cast<int>(instances.size()); }
+    void setInstancing(bool enable) { instancing = enable; }
+    bool getInstancing() const { return instancing; }
+    
+    // count instances on a square grid in the XZ plane, centered on the
+    // origin, spacing units apart, each with its own tint
+    static std::vector<MeshInstance> makeInstanceGrid(int count, float spacing);
+    
     // Rendering methods
     void update();
     void render();
     
     // Vertex buffer update
     void updateVertexBuffer();
+    
+    // Switch the GPU vertex buffer between the float and compact layouts
+    void setCompactVertices(bool compact);
+    bool getCompactVertices() const { return compactVertices; }
+    size_t getVertexBufferBytes() const { return vertices.size() * getVertexSize(); }
+    
+    // GPU memory held for the mesh: its arena ranges and instancing buffers
+    size_t getGpuBytes() const;
 };
 
 #endif // MESH_H
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "mesh_arena.h"
+#include "mesh.h"
+#include <algorithm>
+#include <cstddef>
+
+MeshArena::MeshArena()
+    : vertexRanges(MESH_ARENA_INITIAL_VERTEX_BYTES), indexRanges(MESH_ARENA_INITIAL_INDICES), defragmentCount(0) {
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexRanges.getCapacity(), NULL, GL_STATIC_DRAW);
+    
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexRanges.getCapacity() * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    // Attribute formats are fixed per VAO; only the buffers behind the
+    // bindings change when the arena grows
+    glGenVertexArrays(4, &vertexArrays[0][0]);
+    for (int compact = 0; compact < 2; compact++) {
+        for (int instanced = 0; instanced < 2; instanced++) {
+            setupVertexArray(vertexArrays[compact][instanced], compact != 0, instanced != 0);
+        }
+    }
+    attachBuffers();
+}
+
+MeshArena::~MeshArena() {
+    glDeleteVertexArrays(4, &vertexArrays[0][0]);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+}
+
+void MeshArena::setupVertexArray(GLuint vao, bool compact, bool instanced) {
+    glBindVertexArray(vao);
+    
+    // Per-vertex attributes from binding 0
+    if (compact) {
+        // Position and normal: snorm16, color: unorm8
+        glVertexAttribFormat(0, 3, GL_SHORT, GL_TRUE, offsetof(PackedMeshVertex, position));
+        glVertexAttribFormat(1, 2, GL_SHORT, GL_TRUE, offsetof(PackedMeshVertex, normal));
+        glVertexAttribFormat(2, 3, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(PackedMeshVertex, color));
+    } else {
+        glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, position));
+        glVertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, normal));
+        glVertexAttribFormat(2, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, color));
+    }
+    for (GLuint attribute = 0; attribute < 3; attribute++) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribBinding(attribute, 0);
+    }
+    
+    // Per-instance model matrix (four columns) and tint from binding 1.
+    // Without them the shader reads the constant attribute values.
+    if (instanced) {
+        for (GLuint column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(3 + column);
+            glVertexAttribFormat(3 + column, 4, GL_FLOAT, GL_FALSE,
+                                 offsetof(MeshInstance, transform) + column * sizeof(glm::vec4));
+            glVertexAttribBinding(3 + column, 1);
+        }
+        glEnableVertexAttribArray(7);
+        glVertexAttribFormat(7, 4, GL_FLOAT, GL_FALSE, offsetof(MeshInstance, color));
+        glVertexAttribBinding(7, 1);
+        glVertexBindingDivisor(1, 1);
+    }
+    
+    glBindVertexArray(0);
+}
+
+void MeshArena::attachBuffers() {
+    for (int compact = 0; compact < 2; compact++) {
+        GLsizei stride = compact ? sizeof(PackedMeshVertex) : sizeof(MeshVertex);
+        for (int instanced = 0; instanced < 2; instanced++) {
+            glBindVertexArray(vertexArrays[compact][instanced]);
+            glBindVertexBuffer(0, vertexBuffer, 0, stride);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+// Allocate from one of the buffers. If no free range is large enough, the
+// live ranges are packed into a new buffer, which is also grown when the
+// free space in total is too small. The copy happens on the GPU.
+int MeshArena::allocate(OffsetAllocator& ranges, GLuint& buffer, size_t unitBytes, size_t size, size_t alignment) {
+    int handle = ranges.allocate(size, alignment);
+    if (handle >= 0) {
+        return handle;
+    }
+    
+    // Grow by at least the current capacity when packing alone would leave
+    // the buffer nearly full, so growth is amortized
+    size_t minimumFree = size + alignment;
+    if (ranges.getUsed() + minimumFree > ranges.getCapacity()) {
+        minimumFree = std::max(minimumFree, ranges.getCapacity());
+    }
+    std::vector<OffsetAllocator::Move> moves = ranges.defragment(minimumFree);
+    
+    GLuint packed;
+    glGenBuffers(1, &packed);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, packed);
+    glBufferData(GL_COPY_WRITE_BUFFER, ranges.getCapacity() * unitBytes, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    for (const OffsetAllocator::Move& move : moves) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.from * unitBytes, move.to * unitBytes,
+                            move.size * unitBytes);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = packed;
+    
+    attachBuffers();
+    defragmentCount++;
+    return ranges.allocate(size, alignment);
+}
+
+int MeshArena::allocateVertices(size_t count, size_t vertexSize) {
+    return allocate(vertexRanges, vertexBuffer, 1, count * vertexSize, vertexSize);
+}
+
+int MeshArena::allocateIndices(size_t count) {
+    return allocate(indexRanges, indexBuffer, sizeof(unsigned int), count, 1);
+}
+
+void MeshArena::uploadVertices(int handle, const void* data, size_t bytes) {
+    bytes = std::min(bytes, vertexRanges.getSize(handle));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexRanges.getOffset(handle), bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshArena::uploadIndices(int handle, const unsigned int* data, size_t count) {
+    count = std::min(count, indexRanges.getSize(handle));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexRanges.getOffset(handle) * sizeof(unsigned int),
+                    count * sizeof(unsigned int), data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshArena::bindVertexArray(bool compact, GLuint instanceBuffer) const {
+    bool instanced = instanceBuffer != 0;
+    glBindVertexArray(vertexArrays[compact ? 1 : 0][instanced ? 1 : 0]);
+    if (instanced) {
+        glBindVertexBuffer(1, instanceBuffer, 0, sizeof(MeshInstance));
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include "offset_allocator.h"
+
+// Initial sizes of the shared buffers; both grow when they run out
+const size_t MESH_ARENA_INITIAL_VERTEX_BYTES = 16u << 20;    // 16 MB
+const size_t MESH_ARENA_INITIAL_INDICES = 4u << 20;          // 4M indices, 16 MB
+
+// One vertex buffer and one index buffer shared by every loaded mesh.
+// Meshes sub-allocate ranges out of them instead of creating their own
+// buffers, so loading and unloading models does not create or delete GL
+// buffers, and all meshes draw from the same few VAOs with base-vertex
+// draws: a mesh's indices are stored as they are and its range offsets
+// become the firstIndex and baseVertex of its draws.
+//
+// Vertex ranges are aligned to the vertex size of their layout, so the
+// float (MeshVertex) and compact (PackedMeshVertex) layouts can share the
+// buffer with a VAO each. When a range does not fit, the live ranges are
+// packed to the front of a new, possibly larger buffer on the GPU; ranges
+// move, so offsets must be queried when drawing rather than kept.
+class MeshArena {
+private:
+    GLuint vertexBuffer, indexBuffer;
+    OffsetAllocator vertexRanges;       // In bytes
+    OffsetAllocator indexRanges;        // In indices
+    
+    // [compact][instanced]; the instanced VAOs read per-instance data
+    // from binding 1, which each draw attaches
+    GLuint vertexArrays[2][2];
+    
+    int defragmentCount;
+    
+    void setupVertexArray(GLuint vao, bool compact, bool instanced);
+    void attachBuffers();
+    int allocate(OffsetAllocator& ranges, GLuint& buffer, size_t unitBytes, size_t size, size_t alignment);
+
+public:
+    MeshArena();
+    ~MeshArena();
+    
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+    
+    // Ranges for count vertices of vertexSize bytes and for count indices;
+    // the returned handles stay valid until freed
+    int allocateVertices(size_t count, size_t vertexSize);
+    int allocateIndices(size_t count);
+    void freeVertices(int handle) { vertexRanges.free(handle); }
+    void freeIndices(int handle) { indexRanges.free(handle); }
+    
+    // Write a whole range
+    void uploadVertices(int handle, const void* data, size_t bytes);
+    void uploadIndices(int handle, const unsigned int* data, size_t count);
+    
+    // Where a range currently is, as draw parameters
+    GLint getBaseVertex(int handle, size_t vertexSize) const {
+        return static_cast<GLint>(vertexRanges.getOffset(handle) / vertexSize);
+    }
+    GLuint getFirstIndex(int handle) const { return static_cast<GLuint>(indexRanges.getOffset(handle)); }
+    
+    // Bind the VAO for a vertex layout. Instanced draws pass the buffer of
+    // MeshInstance records to read per instance.
+    void bindVertexArray(bool compact, GLuint instanceBuffer = 0) const;
+    
+    // Occupancy, for the GUI
+    size_t getVertexBytesUsed() const { return vertexRanges.getUsed(); }
+    size_t getVertexBytesCapacity() const { return vertexRanges.getCapacity(); }
+    size_t getIndexBytesUsed() const { return indexRanges.getUsed() * sizeof(unsigned int); }
+    size_t getIndexBytesCapacity() const { return indexRanges.getCapacity() * sizeof(unsigned int); }
+    int getAllocationCount() const { return vertexRanges.getAllocationCount() + indexRanges.getAllocationCount(); }
+    int getDefragmentCount() const { return defragmentCount; }
+};
+
+#endif // MESH_ARENA_H
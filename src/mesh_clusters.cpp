@@ -0,0 +1,308 @@
+#include "mesh_clusters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+// Below this many clusters per thread, starting threads costs more than
+// the culling they take over
+const int CLUSTER_CULL_MIN_PER_THREAD = 1024;
+
+// While growing a cluster, vertices used in this many most recent steps
+// count as still in the vertex cache
+const unsigned int CLUSTER_RECENT_STEPS = 8;
+
+// Normal cones whose triangles spread wider than this (cosine of the
+// largest angle to the axis) are not worth testing
+const float CLUSTER_MIN_CONE_COSINE = 0.1f;
+
+static void finishCluster(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+                          MeshCluster& cluster) {
+    // Bounding box and the sphere around its center
+    const unsigned int first = cluster.indexOffset, last = cluster.indexOffset + cluster.indexCount;
+    cluster.boundsMin = cluster.boundsMax = positions[indices[first]];
+    for (unsigned int i = first; i < last; i++) {
+        cluster.boundsMin = glm::min(cluster.boundsMin, positions[indices[i]]);
+        cluster.boundsMax = glm::max(cluster.boundsMax, positions[indices[i]]);
+    }
+    cluster.center = (cluster.boundsMin + cluster.boundsMax) * 0.5f;
+    cluster.radius = 0.0f;
+    for (unsigned int i = first; i < last; i++) {
+        cluster.radius = std::max(cluster.radius, glm::length(positions[indices[i]] - cluster.center));
+    }
+
+    // Normal cone around the mean triangle normal
+    std::vector<glm::vec3> normals;
+    glm::vec3 sum(0.0f);
+    for (unsigned int i = first; i + 2 < last; i += 3) {
+        const glm::vec3& p0 = positions[indices[i]];
+        glm::vec3 n = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+        float length = glm::length(n);
+        if (length == 0.0f) continue;
+        normals.push_back(n / length);
+        sum += normals.back();
+    }
+    cluster.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    cluster.coneCutoff = 1.0f;
+    float sumLength = glm::length(sum);
+    if (sumLength == 0.0f) {
+        return;
+    }
+    cluster.coneAxis = sum / sumLength;
+    float minCosine = 1.0f;
+    for (const glm::vec3& n : normals) {
+        minCosine = std::min(minCosine, glm::dot(n, cluster.coneAxis));
+    }
+    if (minCosine > CLUSTER_MIN_CONE_COSINE) {
+        cluster.coneCutoff = std::sqrt(1.0f - minCosine * minCosine);
+    }
+}
+
+void buildClusters(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices,
+                   unsigned int indexOffset, unsigned int indexCount, std::vector<MeshCluster>& clusters) {
+    const size_t triangleCount = indexCount / 3;
+    const unsigned int* tris = indices.data() + indexOffset;
+    
+    // Everything the growth loop reads about a triangle, kept together
+    // since candidates are visited in no particular memory order
+    struct GrowTriangle {
+        glm::vec3 normal, centroid;
+        unsigned int v[3];
+        int candidateOf;    // Cluster it was last made a candidate of
+        bool used;
+    };
+    std::vector<GrowTriangle> grow(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        GrowTriangle& g = grow[t];
+        for (int k = 0; k < 3; k++) g.v[k] = tris[t * 3 + k];
+        const glm::vec3& p0 = positions[g.v[0]];
+        glm::vec3 n = glm::cross(positions[g.v[1]] - p0, positions[g.v[2]] - p0);
+        float length = glm::length(n);
+        g.normal = length > 0.0f ? n / length : glm::vec3(0.0f);
+        g.centroid = (p0 + positions[g.v[1]] + positions[g.v[2]]) / 3.0f;
+        g.candidateOf = -1;
+        g.used = false;
+    }
+    
+    // Triangles around each vertex
+    std::vector<unsigned int> adjacencyOffsets(positions.size() + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        adjacencyOffsets[tris[i] + 1]++;
+    }
+    for (size_t v = 0; v < positions.size(); v++) {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        adjacency[fill[tris[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+    
+    // Clusters grow from a seed triangle over shared vertices. Each step
+    // takes the candidate that adds the fewest new vertices, breaking ties
+    // towards triangles that reuse recently added vertices (vertex cache
+    // order), face the same way as the cluster and lie close to it, which
+    // keeps clusters round and their normal cones narrow. Seeds are taken
+    // in index order, which is vertex cache order.
+    struct GrowVertex {
+        int cluster;        // Cluster it was last added to
+        unsigned int time;  // Step it was last used in
+    };
+    std::vector<GrowVertex> vertexState(positions.size(), GrowVertex{-1, 0});
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> order;
+    order.reserve(triangleCount * 3);
+    const size_t firstCluster = clusters.size();
+    unsigned int time = 0;
+    size_t seed = 0;
+    
+    while (true) {
+        while (seed < triangleCount && grow[seed].used) seed++;
+        if (seed == triangleCount) break;
+        
+        const int id = static_cast<int>(clusters.size());
+        MeshCluster cluster = {};
+        cluster.indexOffset = indexOffset + static_cast<unsigned int>(order.size());
+        unsigned int vertexCount = 0;
+        glm::vec3 normalSum(0.0f), centroidSum(0.0f);
+        float extent = 0.0f;
+        candidates.clear();
+        unsigned int next = static_cast<unsigned int>(seed);
+        
+        while (true) {
+            // Add the triangle and make its unused neighbors candidates
+            GrowTriangle& added = grow[next];
+            added.used = true;
+            time++;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = added.v[k];
+                order.push_back(v);
+                vertexState[v].time = time;
+                if (vertexState[v].cluster != id) {
+                    vertexState[v].cluster = id;
+                    vertexCount++;
+                }
+                for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+                    GrowTriangle& neighbor = grow[adjacency[a]];
+                    if (!neighbor.used && neighbor.candidateOf != id) {
+                        neighbor.candidateOf = id;
+                        candidates.push_back(adjacency[a]);
+                    }
+                }
+            }
+            cluster.indexCount += 3;
+            normalSum += added.normal;
+            centroidSum += added.centroid;
+            glm::vec3 center = centroidSum / static_cast<float>(cluster.indexCount / 3);
+            extent = std::max(extent, glm::length(added.centroid - center));
+            if (cluster.indexCount / 3 >= CLUSTER_MAX_TRIANGLES) break;
+            
+            // Best remaining candidate; ones that no longer fit never will
+            float normalLength = glm::length(normalSum);
+            glm::vec3 axis = normalLength > 0.0f ? normalSum / normalLength : glm::vec3(0.0f);
+            float distanceScale = 0.25f / std::max(extent * extent, 1e-24f);
+            float bestScore = 1e30f;
+            size_t best = SIZE_MAX, write = 0;
+            for (size_t c = 0; c < candidates.size(); c++) {
+                const GrowTriangle& g = grow[candidates[c]];
+                if (g.used) continue;
+                unsigned int newVertices = 0, recent = 0;
+                for (int k = 0; k < 3; k++) {
+                    const GrowVertex& state = vertexState[g.v[k]];
+                    if (state.cluster != id) newVertices++;
+                    else if (time - state.time < CLUSTER_RECENT_STEPS) recent++;
+                }
+                if (vertexCount + newVertices > CLUSTER_MAX_VERTICES) continue;
+                
+                glm::vec3 offset = g.centroid - center;
+                float score = static_cast<float>(newVertices) - 0.6f * static_cast<float>(recent)
+                            + (1.0f - glm::dot(g.normal, axis)) + glm::dot(offset, offset) * distanceScale;
+                if (score < bestScore) {
+                    bestScore = score;
+                    best = write;
+                }
+                candidates[write++] = candidates[c];
+            }
+            candidates.resize(write);
+            if (best == SIZE_MAX) break;
+            next = candidates[best];
+        }
+        
+        clusters.push_back(cluster);
+    }
+    
+    // Write the triangles back in cluster order and finish the bounds
+    std::copy(order.begin(), order.end(), indices.begin() + indexOffset);
+    for (size_t c = firstCluster; c < clusters.size(); c++) {
+        finishCluster(positions, indices, clusters[c]);
+    }
+}
+
+// Clusters [first, last) against the planes, appending merged commands
+static void cullRange(const MeshCluster* clusters, int first, int last, const glm::vec4* planes,
+                      const glm::vec3& modelEye, bool cullBackfaces,
+                      std::vector<DrawElementsIndirectCommand>& commands, ClusterCullStats& stats) {
+    for (int c = first; c < last; c++) {
+        const MeshCluster& cluster = clusters[c];
+
+        // Outside any frustum plane
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++) {
+            outside = glm::dot(glm::vec3(planes[p]), cluster.center) + planes[p].w < -cluster.radius;
+        }
+        if (outside) {
+            stats.frustumCulled++;
+            continue;
+        }
+
+        // Every triangle faces away from the eye
+        if (cullBackfaces && cluster.coneCutoff < 1.0f) {
+            glm::vec3 toCenter = cluster.center - modelEye;
+            if (glm::dot(toCenter, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCenter) + cluster.radius) {
+                stats.backfaceCulled++;
+                continue;
+            }
+        }
+
+        stats.visible++;
+        stats.triangles += cluster.indexCount / 3;
+        if (!commands.empty() && commands.back().firstIndex + commands.back().count == cluster.indexOffset) {
+            commands.back().count += cluster.indexCount;
+        } else {
+            commands.push_back({cluster.indexCount, 1, cluster.indexOffset, 0, 0});
+        }
+    }
+}
+
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+    // Gribb-Hartmann: each plane is the sum or difference of the fourth
+    // row of the matrix and one of the others
+    const glm::mat4& m = viewProjection;
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++) {
+        rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    }
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+    for (int p = 0; p < 6; p++) {
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+    }
+}
+
+ClusterCullStats cullClusters(const MeshCluster* clusters, int clusterCount, const glm::mat4& modelViewProjection,
+                              const glm::vec3& modelEye, bool cullBackfaces,
+                              std::vector<DrawElementsIndirectCommand>& commands) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Frustum planes in model space, so plane distances are in model units
+    // like the cluster radii
+    glm::vec4 planes[6];
+    extractFrustumPlanes(modelViewProjection, planes);
+
+    // Each thread culls a contiguous share and keeps its own commands, so
+    // concatenating them keeps cluster order
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const int numThreads = std::max(1, std::min(hardwareThreads, clusterCount / CLUSTER_CULL_MIN_PER_THREAD));
+    std::vector<std::vector<DrawElementsIndirectCommand>> threadCommands(numThreads);
+    std::vector<ClusterCullStats> threadStats(numThreads);
+    auto cullShare = [&](int t) {
+        int first = static_cast<int>(static_cast<long long>(clusterCount) * t / numThreads);
+        int last = static_cast<int>(static_cast<long long>(clusterCount) * (t + 1) / numThreads);
+        cullRange(clusters, first, last, planes, modelEye, cullBackfaces, threadCommands[t], threadStats[t]);
+    };
+    if (numThreads == 1) {
+        cullShare(0);
+    } else {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++) {
+            threads.emplace_back(cullShare, t);
+        }
+        for (auto& t : threads) t.join();
+    }
+
+    // Compact into one list, merging across thread boundaries too
+    ClusterCullStats stats;
+    stats.clusters = clusterCount;
+    commands.clear();
+    for (int t = 0; t < numThreads; t++) {
+        for (const DrawElementsIndirectCommand& command : threadCommands[t]) {
+            if (!commands.empty() && commands.back().firstIndex + commands.back().count == command.firstIndex) {
+                commands.back().count += command.count;
+            } else {
+                commands.push_back(command);
+            }
+        }
+        stats.visible += threadStats[t].visible;
+        stats.frustumCulled += threadStats[t].frustumCulled;
+        stats.backfaceCulled += threadStats[t].backfaceCulled;
+        stats.triangles += threadStats[t].triangles;
+    }
+    stats.commands = static_cast<int>(commands.size());
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
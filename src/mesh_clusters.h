@@ -0,0 +1,76 @@
+#ifndef MESH_CLUSTERS_H
+#define MESH_CLUSTERS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// GL-free cluster (meshlet) decomposition of indexed triangle meshes and the
+// per-frame culling of clusters against a view.
+//
+// Clusters are grown over shared vertices from seed triangles taken in index
+// order, up to CLUSTER_MAX_VERTICES distinct vertices and
+// CLUSTER_MAX_TRIANGLES triangles, preferring triangles that face the same
+// way and stay close, so their bounds and normal cones are tight. The
+// triangles are rewritten cluster by cluster, which makes every cluster a
+// contiguous index range and a set of visible clusters a set of ranges that
+// can be drawn as they are.
+
+const unsigned int CLUSTER_MAX_VERTICES = 64;
+const unsigned int CLUSTER_MAX_TRIANGLES = 128;
+
+struct MeshCluster {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+
+    // Bounds in model space: box, and the sphere around the box center
+    glm::vec3 boundsMin, boundsMax;
+    glm::vec3 center;
+    float radius;
+
+    // Normal cone: every triangle normal is within the cone around coneAxis.
+    // coneCutoff is the sine of its half angle, or 1 when the cone is too
+    // wide to ever cull the cluster as back-facing.
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Layout of one glMultiDrawElementsIndirect command
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+struct ClusterCullStats {
+    int clusters = 0;
+    int visible = 0;
+    int frustumCulled = 0;
+    int backfaceCulled = 0;
+    int commands = 0;               // Draw commands after merging adjacent clusters
+    long long triangles = 0;        // Triangles in the visible clusters
+    double milliseconds = 0.0;
+};
+
+// Split indices[indexOffset, indexOffset + indexCount) into clusters,
+// reordering the triangles in that range, and append them to clusters. The
+// range should already be in vertex cache order; growth roughly keeps it.
+void buildClusters(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices,
+                   unsigned int indexOffset, unsigned int indexCount, std::vector<MeshCluster>& clusters);
+
+// The six frustum planes (left, right, bottom, top, near, far) of a
+// projection matrix, in the space it maps from, as (normal, distance) with
+// unit normals pointing inwards
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+// Cull clusters against the frustum of modelViewProjection and, when
+// cullBackfaces is set, against the eye position in model space. The
+// surviving clusters become draw commands in cluster order, with runs of
+// adjacent clusters merged into one command. Runs on several threads when
+// there are enough clusters to be worth it.
+ClusterCullStats cullClusters(const MeshCluster* clusters, int clusterCount, const glm::mat4& modelViewProjection,
+                              const glm::vec3& modelEye, bool cullBackfaces,
+                              std::vector<DrawElementsIndirectCommand>& commands);
+
+#endif // MESH_CLUSTERS_H
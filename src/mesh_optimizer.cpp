@@ -0,0 +1,208 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+
+// Size of the LRU cache the triangle order is optimized for, and the weights
+// of Forsyth's vertex score: vertices in the cache score by how recently they
+// were used (the last triangle's three vertices get a fixed, lower score so
+// the next triangle does not reuse only them), and vertices with few
+// triangles left get a boost so they are finished off instead of stranded.
+const int FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+// Valences above this share the score of the largest one
+const int FORSYTH_MAX_VALENCE = 64;
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize) {
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0) {
+        return stats;
+    }
+
+    // A vertex is in the FIFO while fewer than cacheSize misses happened
+    // after its own miss
+    std::vector<long long> missTime(vertexCount, -1);
+    std::vector<char> referenced(vertexCount, 0);
+    long long misses = 0;
+    size_t unique = 0;
+    for (unsigned int v : indices) {
+        if (missTime[v] < 0 || misses - missTime[v] >= cacheSize) {
+            missTime[v] = misses++;
+        }
+        if (!referenced[v]) {
+            referenced[v] = 1;
+            unique++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Score tables by cache position and by remaining valence
+    float cacheScores[FORSYTH_CACHE_SIZE];
+    for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+        if (i < 3) {
+            cacheScores[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+        } else {
+            float scaler = 1.0f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3);
+            cacheScores[i] = std::pow(scaler, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+    float valenceScores[FORSYTH_MAX_VALENCE + 1];
+    valenceScores[0] = 0.0f;
+    for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++) {
+        valenceScores[i] = FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -FORSYTH_VALENCE_BOOST_POWER);
+    }
+    auto vertexScore = [&](int cachePosition, int valence) {
+        if (valence == 0) {
+            return -1.0f; // No triangles left to draw with this vertex
+        }
+        float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+        return score + valenceScores[std::min(valence, FORSYTH_MAX_VALENCE)];
+    };
+
+    // Triangles using each vertex, as offsets into one flat list. The first
+    // valence[v] entries of a vertex's range are its triangles not yet drawn.
+    std::vector<int> valence(vertexCount, 0);
+    for (unsigned int v : indices) {
+        valence[v]++;
+    }
+    std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+    }
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<int>(t);
+        }
+    }
+
+    // Initial scores: nothing is cached
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        scores[v] = vertexScore(-1, valence[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    int best = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const unsigned int* tri = &indices[t * 3];
+        triangleScores[t] = scores[tri[0]] + scores[tri[1]] + scores[tri[2]];
+        if (triangleScores[t] > triangleScores[best]) {
+            best = static_cast<int>(t);
+        }
+    }
+
+    // Cache contents, most recent first, with room for the three vertices
+    // the next triangle pushes in front
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<unsigned int> result(indices.size());
+    size_t emittedCount = 0;
+    size_t scanCursor = 0;
+
+    while (best >= 0) {
+        const unsigned int* tri = &indices[static_cast<size_t>(best) * 3];
+
+        // Draw the triangle and remove it from its vertices' lists
+        emitted[best] = 1;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            result[emittedCount * 3 + k] = v;
+            int begin = adjacencyOffsets[v];
+            int end = begin + valence[v];
+            for (int a = begin; a < end; a++) {
+                if (adjacency[a] == best) {
+                    std::swap(adjacency[a], adjacency[end - 1]);
+                    break;
+                }
+            }
+            valence[v]--;
+        }
+        emittedCount++;
+
+        // Its vertices move to the front of the cache; everything else
+        // shifts back, and vertices pushed past the end drop out
+        nextCache.assign(tri, tri + 3);
+        for (unsigned int v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                nextCache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < static_cast<size_t>(FORSYTH_CACHE_SIZE) ? static_cast<int>(i) : -1;
+            scores[v] = vertexScore(cachePosition[v], valence[v]);
+        }
+
+        // Rescore the triangles of every vertex whose score changed and pick
+        // the best of them to draw next
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : nextCache) {
+            int begin = adjacencyOffsets[v];
+            int end = begin + valence[v];
+            for (int a = begin; a < end; a++) {
+                int t = adjacency[a];
+                const unsigned int* other = &indices[static_cast<size_t>(t) * 3];
+                triangleScores[t] = scores[other[0]] + scores[other[1]] + scores[other[2]];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (nextCache.size() > static_cast<size_t>(FORSYTH_CACHE_SIZE)) {
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        cache.swap(nextCache);
+
+        // Nothing in the cache has triangles left: continue with the next
+        // triangle not drawn yet, in the original order
+        if (best < 0 && emittedCount < triangleCount) {
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+            best = static_cast<int>(scanCursor);
+        }
+    }
+
+    indices.swap(result);
+}
+
+std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, size_t vertexCount) {
+    const unsigned int unassigned = ~0u;
+    std::vector<unsigned int> remap(vertexCount, unassigned);
+    unsigned int next = 0;
+    for (unsigned int& v : indices) {
+        if (remap[v] == unassigned) {
+            remap[v] = next++;
+        }
+        v = remap[v];
+    }
+
+    // Unused vertices go last
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == unassigned) {
+            remap[v] = next++;
+        }
+    }
+    return remap;
+}
@@ -0,0 +1,47 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+
+// GL-free index and vertex reordering for indexed triangle lists. Meshes are
+// optimized once at load: triangles are reordered so consecutive triangles
+// share vertices while they are still in the GPU's post-transform cache
+// (Forsyth's linear-speed vertex cache optimization), then vertices are
+// renumbered in the order the new index buffer first uses them, so vertex
+// fetches (GPU) and vertex array reads (CPU) walk memory mostly forwards.
+
+// FIFO cache size used to measure index buffers. Desktop GPUs have caches of
+// a few dozen entries; 16 keeps the statistics comparable with most tools.
+const int VERTEX_CACHE_ANALYZE_SIZE = 16;
+
+// Post-transform cache efficiency of an index buffer
+struct VertexCacheStats {
+    float acmr = 0.0f;  // Average cache miss ratio: vertex shader runs per triangle (0.5 to 3)
+    float atvr = 0.0f;  // Average transformed vertex ratio: shader runs per referenced vertex (1 is ideal)
+};
+
+// Simulate a FIFO post-transform cache over the index buffer
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+                                    int cacheSize = VERTEX_CACHE_ANALYZE_SIZE);
+
+// Reorder the triangles of the index buffer for the post-transform cache.
+// The triangles themselves, and their winding, are unchanged.
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Renumber vertices in order of first use by the index buffer and rewrite
+// the indices to match. Returns the old-to-new vertex map; vertices that no
+// triangle uses keep their relative order after all used ones.
+std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Move vertices to the positions given by an old-to-new map
+template <typename T>
+void remapVertices(std::vector<T>& vertices, const std::vector<unsigned int>& remap) {
+    std::vector<T> remapped(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        remapped[remap[i]] = vertices[i];
+    }
+    vertices.swap(remapped);
+}
+
+#endif // MESH_OPTIMIZER_H
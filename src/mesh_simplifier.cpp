@@ -0,0 +1,202 @@
+#include "mesh_simplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// A collapse is rejected if any triangle around the moving vertex would
+// turn by more than about 78 degrees (cosine below this)
+const float SIMPLIFY_MIN_NORMAL_COSINE = 0.2f;
+
+MeshSimplifier::MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+    : positions(positions), quadrics(positions.size()), locked(positions.size(), 0), indices(indices), error(0.0f) {
+    // Plane quadric of every triangle, weighted by its area
+    for (Quadric& q : quadrics) {
+        q = Quadric{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    }
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const glm::vec3& p0 = positions[indices[t]];
+        glm::vec3 n = glm::cross(positions[indices[t + 1]] - p0, positions[indices[t + 2]] - p0);
+        float length = glm::length(n);
+        if (length == 0.0f) continue;
+        n /= length;
+        double d = -glm::dot(n, p0);
+        double w = length * 0.5;
+
+        Quadric q;
+        q.a00 = w * n.x * n.x; q.a11 = w * n.y * n.y; q.a22 = w * n.z * n.z;
+        q.a01 = w * n.x * n.y; q.a02 = w * n.x * n.z; q.a12 = w * n.y * n.z;
+        q.b0 = w * n.x * d; q.b1 = w * n.y * d; q.b2 = w * n.z * d;
+        q.c = w * d * d;
+        q.weight = w;
+        for (int k = 0; k < 3; k++) {
+            addQuadric(quadrics[indices[t + k]], q);
+        }
+    }
+}
+
+void MeshSimplifier::addQuadric(Quadric& q, const Quadric& other) {
+    q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+    q.a01 += other.a01; q.a02 += other.a02; q.a12 += other.a12;
+    q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// Weighted sum of squared distances from p to the quadric's planes
+double MeshSimplifier::evaluate(const Quadric& q, const glm::vec3& p) {
+    double x = p.x, y = p.y, z = p.z;
+    double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+             + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+             + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+    return std::max(r, 0.0);
+}
+
+// Would moving `from` onto `to` turn any of from's remaining triangles over
+// (or squash it flat)? Triangles are taken with the collapses already made
+// in this pass applied, so the check is exact even when neighbors moved.
+// Triangles that end up containing `to` disappear and are skipped.
+bool MeshSimplifier::flipsTriangle(unsigned int from, unsigned int to) const {
+    for (int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+        const unsigned int* tri = &indices[static_cast<size_t>(adjacency[a]) * 3];
+        unsigned int v[3] = { remap[tri[0]], remap[tri[1]], remap[tri[2]] };
+        if (v[0] == to || v[1] == to || v[2] == to) continue;
+        if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2]) continue;
+
+        glm::vec3 p[3], q[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = positions[v[k]];
+            q[k] = v[k] == from ? positions[to] : p[k];
+        }
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+        float lengths = glm::length(before) * glm::length(after);
+        if (glm::dot(before, after) <= SIMPLIFY_MIN_NORMAL_COSINE * lengths) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t MeshSimplifier::collapsePass(size_t targetIndexCount, float maxError) {
+    const size_t vertexCount = positions.size();
+    const size_t triangleCount = indices.size() / 3;
+
+    // Triangles around each vertex
+    adjacencyOffsets.assign(vertexCount + 1, 0);
+    for (unsigned int v : indices) {
+        adjacencyOffsets[v + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    adjacency.resize(indices.size());
+    std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<int>(t);
+        }
+    }
+
+    // Edges from each vertex to its higher-numbered neighbors, with the
+    // number of triangles using them. An edge used once lies on an open
+    // boundary, and boundary vertices never move.
+    edges.clear();
+    for (size_t v = 0; v < vertexCount; v++) {
+        size_t first = edges.size();
+        for (int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+            const unsigned int* tri = &indices[static_cast<size_t>(adjacency[a]) * 3];
+            for (int k = 0; k < 3; k++) {
+                if (tri[k] <= v) continue;
+                size_t e = first;
+                while (e < edges.size() && edges[e].other != tri[k]) e++;
+                if (e == edges.size()) {
+                    edges.push_back({static_cast<unsigned int>(v), tri[k], 0});
+                }
+                edges[e].triangles++;
+            }
+        }
+        for (size_t e = first; e < edges.size(); e++) {
+            if (edges[e].triangles == 1) {
+                locked[v] = 1;
+                locked[edges[e].other] = 1;
+            }
+        }
+    }
+
+    // Cheapest direction of every edge
+    collapses.clear();
+    for (const Edge& edge : edges) {
+        unsigned int a = edge.vertex, b = edge.other;
+        if (locked[a] && locked[b]) continue;
+        Quadric q = quadrics[a];
+        addQuadric(q, quadrics[b]);
+        double scale = q.weight > 0.0 ? 1.0 / q.weight : 0.0;
+        double costAB = locked[a] ? 1e30 : evaluate(q, positions[b]) * scale;
+        double costBA = locked[b] ? 1e30 : evaluate(q, positions[a]) * scale;
+        if (costAB <= costBA) {
+            collapses.push_back({static_cast<float>(costAB), a, b});
+        } else {
+            collapses.push_back({static_cast<float>(costBA), b, a});
+        }
+    }
+
+    // Every edge locked (triangle soup, a lone triangle, or a level that
+    // is all boundary by now): nothing can be collapsed
+    if (collapses.empty()) {
+        return 0;
+    }
+
+    // Only the cheapest candidates can be used in this pass: each collapse
+    // removes about two triangles, so twice the needed number leaves room
+    // for rejected ones. The rest wait for the next pass.
+    const size_t trianglesToRemove = (indices.size() - targetIndexCount + 2) / 3;
+    auto byCost = [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; };
+    size_t candidates = std::min(collapses.size(), trianglesToRemove + 1);
+    std::nth_element(collapses.begin(), collapses.begin() + (candidates - 1), collapses.end(), byCost);
+    collapses.resize(candidates);
+    std::sort(collapses.begin(), collapses.end(), byCost);
+
+    // Take the cheapest collapses. A vertex takes part in at most one
+    // collapse per pass, as either end, so every remap is a single step.
+    remap.resize(vertexCount);
+    std::iota(remap.begin(), remap.end(), 0u);
+    touched.assign(vertexCount, 0);
+    const float maxCost = maxError * maxError;
+    size_t removed = 0, collapsed = 0;
+    for (const Collapse& c : collapses) {
+        if (removed >= trianglesToRemove || c.cost > maxCost) break;
+        if (touched[c.from] || touched[c.to] || flipsTriangle(c.from, c.to)) continue;
+
+        // Triangles of `from` that now also contain `to` collapse
+        for (int a = adjacencyOffsets[c.from]; a < adjacencyOffsets[c.from + 1]; a++) {
+            const unsigned int* tri = &indices[static_cast<size_t>(adjacency[a]) * 3];
+            unsigned int v[3] = { remap[tri[0]], remap[tri[1]], remap[tri[2]] };
+            bool degenerate = v[0] == v[1] || v[1] == v[2] || v[0] == v[2];
+            if (!degenerate && (v[0] == c.to || v[1] == c.to || v[2] == c.to)) removed++;
+        }
+
+        remap[c.from] = c.to;
+        addQuadric(quadrics[c.to], quadrics[c.from]);
+        error = std::max(error, std::sqrt(c.cost));
+        touched[c.from] = touched[c.to] = 1;
+        collapsed++;
+    }
+
+    // Rewrite the triangles and drop the ones that collapsed
+    size_t write = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        unsigned int a = remap[indices[t * 3]], b = remap[indices[t * 3 + 1]], c = remap[indices[t * 3 + 2]];
+        if (a == b || b == c || a == c) continue;
+        indices[write++] = a;
+        indices[write++] = b;
+        indices[write++] = c;
+    }
+    indices.resize(write);
+    return collapsed;
+}
+
+void MeshSimplifier::simplify(size_t targetIndexCount, float maxError) {
+    while (indices.size() > targetIndexCount) {
+        if (collapsePass(targetIndexCount, maxError) == 0) break;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+
+// GL-free quadric error metric (Garland-Heckbert) simplifier for indexed
+// triangle meshes. Edges are collapsed onto one of their end points
+// (half-edge collapses), so every level of detail it produces is just an
+// index buffer over the original vertices and all levels can share one
+// vertex buffer.
+//
+// Each vertex carries the area-weighted sum of the quadrics of the planes
+// of its triangles; collapsing u onto v costs the weighted mean squared
+// distance of v's position to the planes of both. Collapses are applied in
+// passes: all edges are ranked by cost and the cheapest ones are taken,
+// skipping vertices already collapsed onto or away in the pass, collapses
+// that would flip a triangle, and vertices on open boundaries.
+class MeshSimplifier {
+private:
+    // Symmetric 4x4 plane quadric, stored as its 10 distinct entries, and
+    // the total triangle area that went into it
+    struct Quadric {
+        double a00, a11, a22, a01, a02, a12, b0, b1, b2, c;
+        double weight;
+    };
+
+    struct Edge {
+        unsigned int vertex, other;   // vertex < other
+        int triangles;                // Number of triangles using the edge
+    };
+
+    struct Collapse {
+        float cost;
+        unsigned int from, to;
+    };
+
+    std::vector<glm::vec3> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<char> locked;
+    std::vector<unsigned int> indices;
+    float error;
+
+    // Scratch reused by every pass
+    std::vector<Edge> edges;
+    std::vector<int> adjacencyOffsets;
+    std::vector<int> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> remap;
+    std::vector<char> touched;
+
+    static void addQuadric(Quadric& q, const Quadric& other);
+    static double evaluate(const Quadric& q, const glm::vec3& p);
+    bool flipsTriangle(unsigned int from, unsigned int to) const;
+    size_t collapsePass(size_t targetIndexCount, float maxError);
+
+public:
+    MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+
+    // Collapse edges until at most targetIndexCount indices remain, no edge
+    // can be collapsed with an error below maxError, or no collapse is
+    // possible. Can be called repeatedly with smaller targets to build a
+    // chain of levels of detail; quadrics carry over between calls.
+    void simplify(size_t targetIndexCount, float maxError = 1e30f);
+
+    // Current triangles, and the largest error (in position units) of any
+    // collapse made so far
+    const std::vector<unsigned int>& getIndices() const { return indices; }
+    float getError() const { return error; }
+};
+
+#endif // MESH_SIMPLIFIER_H
@@ -0,0 +1,116 @@
+#include "model_cache.h"
+#include "mesh_clusters.h"
+#include "process_memory.h"
+#include <algorithm>
+
+ModelCache::ModelCache(size_t ramBudget, size_t vramBudget)
+    : ramBudget(ramBudget), vramBudget(vramBudget), hits(0), misses(0), evictions(0) {
+}
+
+ModelCache::~ModelCache() {
+    for (CachedModel& model : models) {
+        release(model);
+    }
+}
+
+// Read the file and build the mesh and slicer. The OffModel is only the
+// input to Mesh and is freed as soon as the mesh exists, leaving the mesh
+// as the single CPU copy of the geometry.
+CachedModel ModelCache::load(const std::string& path) {
+    CachedModel model = { path, nullptr, nullptr, ModelMemory() };
+    trimFreedMemory();
+    resetPeakResidentBytes();
+    size_t residentBefore = getResidentBytes();
+    
+    OffModel* offModel = readOffFile(const_cast<char*>(path.c_str()));
+    if (!offModel) {
+        return model;
+    }
+    computeNormals(offModel);
+    model.mesh = new Mesh(offModel);
+    FreeOffModel(offModel);
+    model.slicer = new MeshSlicer(model.mesh);
+    
+    model.memory = measure(model);
+    trimFreedMemory();
+    model.memory.loadPeak = getPeakResidentBytes() - std::min(residentBefore, getPeakResidentBytes());
+    model.memory.loadResident = getResidentBytes() - std::min(residentBefore, getResidentBytes());
+    return model;
+}
+
+void ModelCache::release(CachedModel& model) {
+    // The slicer refers to the mesh
+    delete model.slicer;
+    delete model.mesh;
+    model.slicer = nullptr;
+    model.mesh = nullptr;
+}
+
+ModelMemory ModelCache::measure(const CachedModel& model) {
+    ModelMemory memory = ModelMemory();
+    memory.vertices = model.mesh->getVertices().capacity() * sizeof(MeshVertex);
+    memory.indices = model.mesh->getIndices().capacity() * sizeof(unsigned int);
+    memory.acceleration = model.mesh->getClusters().capacity() * sizeof(MeshCluster);
+    memory.gpu = model.mesh->getGpuBytes();
+    return memory;
+}
+
+// Unload least recently used models until both budgets are met, keeping
+// at least the one in use
+void ModelCache::evict() {
+    while (models.size() > 1 && (getRamUsed() > ramBudget || getVramUsed() > vramBudget)) {
+        release(models.back());
+        models.pop_back();
+        evictions++;
+    }
+}
+
+CachedModel* ModelCache::acquire(const std::string& path) {
+    for (auto it = models.begin(); it != models.end(); ++it) {
+        if (it->path == path) {
+            hits++;
+            models.splice(models.begin(), models, it);
+            return &models.front();
+        }
+    }
+    
+    // The size of a model is only known once it is loaded, so the budget
+    // can be exceeded by up to one model until the eviction below
+    CachedModel model = load(path);
+    if (!model.mesh) {
+        return nullptr;
+    }
+    misses++;
+    models.push_front(model);
+    evict();
+    return &models.front();
+}
+
+void ModelCache::setBudget(size_t ram, size_t vram) {
+    ramBudget = ram;
+    vramBudget = vram;
+    evict();
+}
+
+void ModelCache::update() {
+    for (CachedModel& model : models) {
+        model.memory.gpu = model.mesh->getGpuBytes();
+    }
+    evict();
+}
+
+size_t ModelCache::getRamUsed() const {
+    size_t bytes = 0;
+    for (const CachedModel& model : models) {
+        bytes += model.memory.getRamBytes();
+    }
+    return bytes;
+}
+
+size_t ModelCache::getVramUsed() const {
+    size_t bytes = 0;
+    for (const CachedModel& model : models) {
+        bytes += model.memory.gpu;
+    }
+    return bytes;
+}
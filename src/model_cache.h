@@ -0,0 +1,84 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include "mesh.h"
+#include "slicer.h"
+
+// Default budgets; the GUI can change them at run time
+const size_t MODEL_CACHE_DEFAULT_RAM_BUDGET = 1024u << 20;     // 1 GB
+const size_t MODEL_CACHE_DEFAULT_VRAM_BUDGET = 512u << 20;     // 512 MB
+
+// Memory held by one resident model, per representation, in bytes
+struct ModelMemory {
+    size_t vertices;        // Mesh::vertices
+    size_t indices;         // Mesh::indices, all levels of detail
+    size_t acceleration;    // Mesh clusters, used by culling, slicer and ray tracer
+    size_t gpu;             // Arena ranges and instancing buffers
+    
+    // Growth of the process resident set size while loading, at its peak
+    // and once loading finished
+    size_t loadPeak;
+    size_t loadResident;
+    
+    size_t getRamBytes() const { return vertices + indices + acceleration; }
+};
+
+// A loaded model: the mesh, its single CPU and GPU copy of the geometry,
+// and the slicer working on it
+struct CachedModel {
+    std::string path;
+    Mesh* mesh;
+    MeshSlicer* slicer;
+    ModelMemory memory;
+};
+
+// Keeps recently used models resident, in CPU and GPU form, so switching
+// back to one does not read, simplify and cluster it again. Models are
+// kept in order of use and the least recently used ones are unloaded when
+// the resident set exceeds the RAM or the VRAM budget. The model in use is
+// never unloaded, even if it alone exceeds a budget.
+class ModelCache {
+private:
+    std::list<CachedModel> models;      // Most recently used first
+    size_t ramBudget, vramBudget;
+    int hits, misses, evictions;
+    
+    static CachedModel load(const std::string& path);
+    static void release(CachedModel& model);
+    static ModelMemory measure(const CachedModel& model);
+    void evict();
+
+public:
+    ModelCache(size_t ramBudget = MODEL_CACHE_DEFAULT_RAM_BUDGET,
+               size_t vramBudget = MODEL_CACHE_DEFAULT_VRAM_BUDGET);
+    ~ModelCache();
+    
+    ModelCache(const ModelCache&) = delete;
+    ModelCache& operator=(const ModelCache&) = delete;
+    
+    // The model at path, loaded from disk unless resident, made the most
+    // recently used. Returns nullptr if the file cannot be read, in which
+    // case nothing is unloaded. Pointers to other models may be invalidated.
+    CachedModel* acquire(const std::string& path);
+    
+    // Change the budgets, unloading models as needed
+    void setBudget(size_t ram, size_t vram);
+    size_t getRamBudget() const { return ramBudget; }
+    size_t getVramBudget() const { return vramBudget; }
+    
+    // Re-measure the GPU memory of the resident models, whose instance
+    // buffers can change after loading, and unload models if needed
+    void update();
+    
+    const std::list<CachedModel>& getModels() const { return models; }
+    size_t getRamUsed() const;
+    size_t getVramUsed() const;
+    int getHits() const { return hits; }
+    int getMisses() const { return misses; }
+    int getEvictions() const { return evictions; }
+};
+
+#endif // MODEL_CACHE_H
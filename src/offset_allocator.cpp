@@ -0,0 +1,122 @@
+#include "offset_allocator.h"
+#include <algorithm>
+#include <iterator>
+
+OffsetAllocator::OffsetAllocator(size_t capacity) : capacity(capacity), used(0) {
+    if (capacity > 0) {
+        freeRanges[0] = capacity;
+    }
+}
+
+int OffsetAllocator::allocate(size_t size, size_t alignment) {
+    if (alignment == 0) {
+        return -1;
+    }
+    
+    // An empty range takes no space, so it always fits: it sits at offset
+    // 0, outside the free list, and never moves
+    if (size == 0) {
+        return addRange(0, 0, alignment);
+    }
+    
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        size_t start = it->first, end = it->first + it->second;
+        size_t offset = alignUp(start, alignment);
+        if (offset + size > end) continue;
+        
+        // Split off what is left on either side of the new range
+        freeRanges.erase(it);
+        if (offset > start) {
+            freeRanges[start] = offset - start;
+        }
+        if (offset + size < end) {
+            freeRanges[offset + size] = end - (offset + size);
+        }
+        return addRange(offset, size, alignment);
+    }
+    return -1;
+}
+
+int OffsetAllocator::addRange(size_t offset, size_t size, size_t alignment) {
+    int handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = static_cast<int>(ranges.size());
+        ranges.push_back(Range());
+    }
+    ranges[handle] = {offset, size, alignment, true};
+    used += size;
+    return handle;
+}
+
+void OffsetAllocator::free(int handle) {
+    if (handle < 0 || handle >= static_cast<int>(ranges.size()) || !ranges[handle].live) {
+        return;
+    }
+    Range& range = ranges[handle];
+    range.live = false;
+    used -= range.size;
+    if (range.size > 0) {
+        release(range.offset, range.size);
+    }
+    freeHandles.push_back(handle);
+}
+
+// Return [offset, offset + size) to the free list, merged with free
+// neighbors on both sides
+void OffsetAllocator::release(size_t offset, size_t size) {
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            freeRanges.erase(previous);
+        }
+    }
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        freeRanges.erase(next);
+    }
+    freeRanges[offset] = size;
+}
+
+std::vector<OffsetAllocator::Move> OffsetAllocator::defragment(size_t minimumFree) {
+    std::vector<int> live;
+    for (size_t h = 0; h < ranges.size(); h++) {
+        if (ranges[h].live && ranges[h].size > 0) live.push_back(static_cast<int>(h));
+    }
+    std::sort(live.begin(), live.end(), [this](int a, int b) { return ranges[a].offset < ranges[b].offset; });
+    
+    // Ranges only ever move towards the front, so they stay in order. Gaps
+    // left for alignment stay free.
+    std::vector<Move> moves;
+    freeRanges.clear();
+    size_t end = 0;
+    for (int handle : live) {
+        Range& range = ranges[handle];
+        size_t offset = alignUp(end, range.alignment);
+        if (offset > end) {
+            freeRanges[end] = offset - end;
+        }
+        moves.push_back({handle, range.offset, offset, range.size});
+        range.offset = offset;
+        end = offset + range.size;
+    }
+    
+    capacity = std::max(capacity, end + minimumFree);
+    if (end < capacity) {
+        freeRanges[end] = capacity - end;
+    }
+    return moves;
+}
+
+size_t OffsetAllocator::getLargestFreeRange() const {
+    size_t largest = 0;
+    for (const auto& range : freeRanges) {
+        largest = std::max(largest, range.second);
+    }
+    return largest;
+}
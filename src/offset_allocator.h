@@ -0,0 +1,72 @@
+#ifndef OFFSET_ALLOCATOR_H
+#define OFFSET_ALLOCATOR_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// GL-free sub-allocator of ranges [offset, offset + size) out of a linear
+// space of a given capacity, for carving many meshes out of one buffer.
+//
+// Free space is a list of ranges sorted by offset; allocation takes the
+// first one that fits, and freeing merges a range with free neighbors, so
+// free space only fragments where live ranges separate it. When no single
+// free range is large enough, defragment() packs the live ranges to the
+// front (optionally growing the space) and reports the new layout for the
+// caller to apply to its buffer. Ranges are identified by handles that
+// stay valid across moves.
+class OffsetAllocator {
+public:
+    // Old and new place of a live range after defragmentation
+    struct Move {
+        int handle;
+        size_t from, to;
+        size_t size;
+    };
+
+private:
+    struct Range {
+        size_t offset;
+        size_t size;
+        size_t alignment;
+        bool live;
+    };
+    
+    size_t capacity;
+    size_t used;                            // Sum of live range sizes
+    std::vector<Range> ranges;              // By handle
+    std::vector<int> freeHandles;
+    std::map<size_t, size_t> freeRanges;    // Offset to size
+    
+    static size_t alignUp(size_t offset, size_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+    int addRange(size_t offset, size_t size, size_t alignment);
+    void release(size_t offset, size_t size);
+
+public:
+    explicit OffsetAllocator(size_t capacity);
+    
+    // Handle of a new range of size units starting at a multiple of
+    // alignment, or -1 if no free range can hold it. A range of size 0
+    // always succeeds (at offset 0), so empty meshes need no special case.
+    int allocate(size_t size, size_t alignment = 1);
+    void free(int handle);
+    
+    size_t getOffset(int handle) const { return ranges[handle].offset; }
+    size_t getSize(int handle) const { return ranges[handle].size; }
+    
+    // Pack all live ranges to the front in offset order and grow the space
+    // if needed so at least minimumFree units follow them. Returns where
+    // every live range was and now is (some may not move), for copying the
+    // contents into a new buffer; ranges keep their alignment.
+    std::vector<Move> defragment(size_t minimumFree = 0);
+    
+    size_t getCapacity() const { return capacity; }
+    size_t getUsed() const { return used; }
+    size_t getLargestFreeRange() const;
+    int getFreeRangeCount() const { return static_cast<int>(freeRanges.size()); }
+    int getAllocationCount() const { return static_cast<int>(ranges.size() - freeHandles.size()); }
+};
+
+#endif // OFFSET_ALLOCATOR_H
@@ -0,0 +1,41 @@
+#include "process_memory.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Value of a "Name:   1234 kB" line of /proc/self/status
+static size_t readStatusKilobytes(const char* name) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, line.find(':'), name) == 0) {
+            std::istringstream value(line.substr(line.find(':') + 1));
+            size_t kilobytes = 0;
+            value >> kilobytes;
+            return kilobytes * 1024;
+        }
+    }
+    return 0;
+}
+
+size_t getResidentBytes() {
+    return readStatusKilobytes("VmRSS");
+}
+
+size_t getPeakResidentBytes() {
+    return readStatusKilobytes("VmHWM");
+}
+
+void resetPeakResidentBytes() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+void trimFreedMemory() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
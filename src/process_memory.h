@@ -0,0 +1,20 @@
+#ifndef PROCESS_MEMORY_H
+#define PROCESS_MEMORY_H
+
+#include <cstddef>
+
+// Resident set size of this process and its high-water mark, in bytes,
+// read from /proc/self/status. Both are 0 where that is not available.
+size_t getResidentBytes();
+size_t getPeakResidentBytes();
+
+// Restart the high-water mark from the current resident set size, so the
+// peak of one operation can be measured (Linux 4.0 and later; elsewhere
+// the peak keeps covering the whole run)
+void resetPeakResidentBytes();
+
+// Hand memory freed by the allocator back to the system where supported,
+// so the resident set size reflects what is still in use
+void trimFreedMemory();
+
+#endif // PROCESS_MEMORY_H
@@ -0,0 +1,265 @@
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "process_memory.h"
+
+std::atomic<bool> Profiler::enabled(false);
+std::atomic<bool> Profiler::capturing(false);
+
+static_assert((PROFILER_RING_SIZE & (PROFILER_RING_SIZE - 1)) == 0, "PROFILER_RING_SIZE must be a power of two");
+
+// A ring slot holds the event with ring index sequence - 1. Writers claim
+// an index with one fetch_add, invalidate the slot, write the event and
+// then publish the index; readers check the sequence before and after
+// copying the event and drop it if the slot changed underneath them.
+struct ProfileSlot {
+    std::atomic<uint64_t> sequence;
+    ProfileEvent event;
+};
+
+static ProfileSlot ring[PROFILER_RING_SIZE];
+static std::atomic<uint64_t> writeIndex(0);
+
+// Frames are only touched by the main thread
+static std::vector<ProfileFrame> frames;
+static ProfileFrame currentFrame;
+static bool inFrame = false;
+
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+// Static initialization runs on the main thread
+static const std::thread::id mainThreadId = std::this_thread::get_id();
+static std::atomic<uint32_t> nextThreadId(1);
+thread_local uint32_t threadId = UINT32_MAX;
+thread_local uint32_t threadDepth = 0;
+
+// Capture state. Events are gathered per thread without locking and moved
+// into capturedEvents, under the mutex, when the thread flushes or exits.
+static std::mutex captureMutex;
+static std::vector<TraceEvent> capturedEvents;
+static std::string capturePath;
+static std::string captureStatus;
+static int captureFramesRequested = 0;
+static int captureFramesLeft = 0;
+static int captureFrameNumber = 0;
+static bool captureWasEnabled = false;
+
+struct ThreadTraceBuffer {
+    std::vector<TraceEvent> events;
+    
+    ~ThreadTraceBuffer() { flush(); }
+    void flush() {
+        if (events.empty()) return;
+        std::lock_guard<std::mutex> lock(captureMutex);
+        capturedEvents.insert(capturedEvents.end(), events.begin(), events.end());
+        events.clear();
+    }
+};
+thread_local ThreadTraceBuffer traceBuffer;
+
+static uint32_t getThreadId() {
+    if (threadId == UINT32_MAX) {
+        threadId = std::this_thread::get_id() == mainThreadId ? 0 : nextThreadId.fetch_add(1);
+    }
+    return threadId;
+}
+
+void Profiler::setEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+int64_t Profiler::beginScope() {
+    threadDepth++;
+    return now();
+}
+
+void Profiler::endScope(const char* name, int64_t start, const char* argName, int64_t argValue) {
+    int64_t end = now();
+    threadDepth--;
+    
+    uint64_t index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+    ProfileSlot& slot = ring[index & (PROFILER_RING_SIZE - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = { name, start, end, getThreadId(), threadDepth };
+    slot.sequence.store(index + 1, std::memory_order_release);
+    
+    if (capturing.load(std::memory_order_relaxed)) {
+        traceBuffer.events.push_back({ name, argName, argValue, start, end, getThreadId(), 'X' });
+    }
+}
+
+void Profiler::recordCounter(const char* name, int64_t value) {
+    int64_t time = now();
+    traceBuffer.events.push_back({ name, nullptr, value, time, time, getThreadId(), 'C' });
+}
+
+void Profiler::flushThread() {
+    traceBuffer.flush();
+}
+
+void Profiler::beginFrame() {
+    // Captures start on a frame boundary
+    if (captureFramesRequested > 0 && !capturing.load(std::memory_order_relaxed)) {
+        {
+            std::lock_guard<std::mutex> lock(captureMutex);
+            capturedEvents.clear();
+        }
+        captureFramesLeft = captureFramesRequested;
+        captureFramesRequested = 0;
+        captureFrameNumber = 0;
+        captureWasEnabled = isEnabled();
+        setEnabled(true);
+        capturing.store(true, std::memory_order_relaxed);
+    }
+    
+    inFrame = isEnabled();
+    if (!inFrame) {
+        return;
+    }
+    currentFrame.firstEvent = writeIndex.load(std::memory_order_relaxed);
+    currentFrame.start = now();
+}
+
+void Profiler::endFrame() {
+    if (!inFrame) {
+        return;
+    }
+    currentFrame.end = now();
+    currentFrame.endEvent = writeIndex.load(std::memory_order_relaxed);
+    if (frames.size() >= PROFILER_FRAME_HISTORY) {
+        frames.erase(frames.begin());
+    }
+    frames.push_back(currentFrame);
+    inFrame = false;
+    
+    if (capturing.load(std::memory_order_relaxed)) {
+        traceBuffer.events.push_back({ "frame", "frame", captureFrameNumber++, currentFrame.start, currentFrame.end,
+                                       getThreadId(), 'X' });
+        recordCounter("resident MB", static_cast<int64_t>(getResidentBytes() >> 20));
+        if (--captureFramesLeft == 0) {
+            finishCapture();
+        }
+    }
+}
+
+void Profiler::startCapture(int frameCount, const std::string& path) {
+    if (isCapturing() || frameCount <= 0) {
+        return;
+    }
+    captureFramesRequested = frameCount;
+    capturePath = path;
+    captureStatus = "Capturing " + std::to_string(frameCount) + " frames";
+}
+
+bool Profiler::isCapturing() {
+    return captureFramesRequested > 0 || capturing.load(std::memory_order_relaxed);
+}
+
+const std::string& Profiler::getCaptureStatus() {
+    return captureStatus;
+}
+
+// Names are string literals from the source, but keep the JSON valid
+static void writeJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        if (static_cast<unsigned char>(*c) >= 0x20) fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Stop recording and write the Chrome trace: complete events and counter
+// samples with microsecond times, plus the names of the threads
+void Profiler::finishCapture() {
+    capturing.store(false, std::memory_order_relaxed);
+    setEnabled(captureWasEnabled);
+    traceBuffer.flush();
+    
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(captureMutex);
+        events.swap(capturedEvents);
+    }
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.start < b.start;
+    });
+    
+    FILE* file = fopen(capturePath.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to write trace: " << capturePath << std::endl;
+        captureStatus = "Failed to write " + capturePath;
+        return;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::vector<uint32_t> threads;
+    for (const TraceEvent& event : events) {
+        if (std::find(threads.begin(), threads.end(), event.thread) == threads.end()) {
+            threads.push_back(event.thread);
+        }
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", threads[i]);
+        if (threads[i] == 0) {
+            fprintf(file, "\"main\"}},\n");
+        } else {
+            fprintf(file, "\"worker %u\"}},\n", threads[i]);
+        }
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& event = events[i];
+        fprintf(file, "{\"name\":");
+        writeJsonString(file, event.name);
+        fprintf(file, ",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", event.phase, event.thread, event.start / 1000.0);
+        if (event.phase == 'C') {
+            fprintf(file, ",\"args\":{\"value\":%lld}", static_cast<long long>(event.argValue));
+        } else {
+            fprintf(file, ",\"dur\":%.3f", (event.end - event.start) / 1000.0);
+            if (event.argName) {
+                fprintf(file, ",\"args\":{");
+                writeJsonString(file, event.argName);
+                fprintf(file, ":%lld}", static_cast<long long>(event.argValue));
+            }
+        }
+        fprintf(file, "}%s\n", i + 1 < events.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+    captureStatus = "Wrote " + std::to_string(events.size()) + " events to " + capturePath;
+}
+
+const std::vector<ProfileFrame>& Profiler::getFrames() {
+    return frames;
+}
+
+std::vector<ProfileEvent> Profiler::getFrameEvents(const ProfileFrame& frame) {
+    std::vector<ProfileEvent> events;
+    uint64_t newest = writeIndex.load(std::memory_order_relaxed);
+    uint64_t first = std::max(frame.firstEvent, newest > PROFILER_RING_SIZE ? newest - PROFILER_RING_SIZE : 0);
+    for (uint64_t index = first; index < frame.endEvent; index++) {
+        const ProfileSlot& slot = ring[index & (PROFILER_RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != index + 1) continue;
+        ProfileEvent event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != index + 1) continue;
+        events.push_back(event);
+    }
+    
+    // Scopes are recorded when they close, so children come before their
+    // parents; order them as a depth-first walk per thread instead
+    std::sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+        if (a.thread != b.thread) return a.thread < b.thread;
+        if (a.start != b.start) return a.start < b.start;
+        return a.depth < b.depth;
+    });
+    return events;
+}
@@ -0,0 +1,129 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame profiler: PROFILE_SCOPE("name") times the rest of the enclosing
+// block on any thread. Timings go into a fixed ring of events that threads
+// append to without locking, and the main loop marks frame boundaries so
+// the GUI can graph frame times and break a frame down by nested scope.
+//
+// A capture additionally records the scopes of the next N frames, with
+// their arguments and any PROFILE_COUNTER values, into a buffer per thread
+// and writes them as a Chrome trace event JSON file (chrome://tracing,
+// ui.perfetto.dev). Threads hand their buffer over when they exit;
+// threads that live across frames call Profiler::flushThread() instead.
+//
+// While the profiler is disabled a scope costs one relaxed atomic load;
+// building with -DPROFILER_DISABLED removes the scopes altogether.
+#ifndef PROFILER_DISABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_SCOPE_ARG(name, argName, argValue) \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, argName, argValue)
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, value)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_ARG(name, argName, argValue) ((void)(argValue))
+#define PROFILE_COUNTER(name, value) ((void)0)
+#endif
+
+// Ring capacity in events (a power of two) and frames kept for the graph
+const uint64_t PROFILER_RING_SIZE = 1 << 16;
+const int PROFILER_FRAME_HISTORY = 256;
+
+// Frames a trace capture covers unless told otherwise
+const int PROFILER_DEFAULT_CAPTURE_FRAMES = 60;
+
+// One timed scope; times are nanoseconds since the profiler started
+struct ProfileEvent {
+    const char* name;       // String literal given to PROFILE_SCOPE
+    int64_t start, end;
+    uint32_t thread;        // Small id in order of first use, 0 for the main thread
+    uint32_t depth;         // Scopes open on the thread around this one
+};
+
+// Event of a capture, in Chrome trace terms: a complete event (phase 'X')
+// with an optional integer argument, or a counter sample (phase 'C')
+struct TraceEvent {
+    const char* name;
+    const char* argName;    // nullptr without argument
+    int64_t argValue;       // Counter value for phase 'C'
+    int64_t start, end;
+    uint32_t thread;
+    char phase;
+};
+
+// The events recorded during one frame are those with ring indices in
+// [firstEvent, endEvent), as long as they have not been overwritten
+struct ProfileFrame {
+    uint64_t firstEvent, endEvent;
+    int64_t start, end;
+};
+
+class Profiler {
+private:
+    static std::atomic<bool> enabled;
+    static std::atomic<bool> capturing;
+    
+    static void finishCapture();
+
+public:
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enable);
+    static int64_t now();
+    
+    // Called by ProfileScope: open a scope on this thread and return its
+    // start time, then close it and append it to the ring
+    static int64_t beginScope();
+    static void endScope(const char* name, int64_t start, const char* argName = nullptr, int64_t argValue = 0);
+    
+    // Sample a counter; only recorded during a capture
+    static void counter(const char* name, int64_t value) {
+        if (capturing.load(std::memory_order_relaxed)) recordCounter(name, value);
+    }
+    static void recordCounter(const char* name, int64_t value);
+    
+    // Frame boundaries, from the main loop
+    static void beginFrame();
+    static void endFrame();
+    
+    // Recorded frames, oldest first, and the events of one of them that
+    // are still in the ring, ordered by thread and then start time
+    static const std::vector<ProfileFrame>& getFrames();
+    static std::vector<ProfileEvent> getFrameEvents(const ProfileFrame& frame);
+    
+    // Capture the next frames frames into a Chrome trace file at path. The
+    // profiler records during the capture whether or not it is enabled.
+    static void startCapture(int frames, const std::string& path);
+    static bool isCapturing();
+    static const std::string& getCaptureStatus();     // Outcome of the last capture, for the GUI
+    
+    // Hand the events this thread recorded to the current capture
+    static void flushThread();
+};
+
+class ProfileScope {
+private:
+    const char* name;
+    const char* argName;
+    int64_t argValue;
+    int64_t start;      // -1 when the profiler was disabled on entry
+
+public:
+    explicit ProfileScope(const char* name, const char* argName = nullptr, int64_t argValue = 0)
+        : name(name), argName(argName), argValue(argValue),
+          start(Profiler::isEnabled() ? Profiler::beginScope() : -1) {}
+    ~ProfileScope() {
+        if (start >= 0) Profiler::endScope(name, start, argName, argValue);
+    }
+    
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#endif // PROFILER_H
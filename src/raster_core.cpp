@@ -0,0 +1,747 @@
+#include "raster_core.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+// Height in rows of the tiles that batch fills hand out to worker threads
+const int BATCH_TILE_HEIGHT = 16;
+
+// Height in pixel rows of the bands a single polygon fill is split into, and
+// the number of bands a polygon needs to cover before it is filled in parallel
+const int FILL_BAND_HEIGHT = 32;
+const int FILL_PARALLEL_MIN_BANDS = 4;
+
+// Floor division for a positive divisor (integer division truncates toward zero)
+static inline long long floorDiv(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+// Smallest integer >= a / b for a positive divisor
+static inline long long ceilDiv(long long a, long long b) {
+    return -floorDiv(-a, b);
+}
+
+// Write `count` copies of an RGB color starting at dst. Four pixels make up a
+// 12-float pattern, which the fixed-size memcpy turns into three 16-byte
+// vector stores; the remaining 0-3 pixels are written one by one.
+static inline void fillRGB(float* dst, size_t count, const glm::vec3& color) {
+    const float pattern[12] = {
+        color.r, color.g, color.b, color.r, color.g, color.b,
+        color.r, color.g, color.b, color.r, color.g, color.b
+    };
+    
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        std::memcpy(dst, pattern, sizeof(pattern));
+        dst += 12;
+    }
+    for (; i < count; i++) {
+        dst[0] = color.r;
+        dst[1] = color.g;
+        dst[2] = color.b;
+        dst += 3;
+    }
+}
+
+// Walk the pixels of the Bresenham line (x0, y0) - (x1, y1) that fall inside
+// [xlo, xhi] x [ylo, yhi], calling plot(x, y) for each in line order. Step i
+// along the major axis moves the minor axis by
+//     floor((2 * i * minor + major - 1) / (2 * major)),
+// which is exactly where the classic error-term loop puts it. Solving that
+// for the clip bounds gives the visible step range directly, so pixels
+// outside the rectangle are never visited.
+template <typename Plot>
+static void walkLine(int x0, int y0, int x1, int y1, int xlo, int ylo, int xhi, int yhi, Plot plot) {
+    const int sx = x0 < x1 ? 1 : -1;
+    const int sy = y0 < y1 ? 1 : -1;
+    const bool xMajor = std::abs(x1 - x0) >= std::abs(y1 - y0);
+    
+    // Express everything along the major (a) and minor (b) axes, with both
+    // pointing in the direction of travel
+    const long long major = xMajor ? std::abs(x1 - x0) : std::abs(y1 - y0);
+    const long long minor = xMajor ? std::abs(y1 - y0) : std::abs(x1 - x0);
+    const int a0 = xMajor ? x0 : y0, sa = xMajor ? sx : sy;
+    const int b0 = xMajor ? y0 : x0, sb = xMajor ? sy : sx;
+    const int alo = xMajor ? xlo : ylo, ahi = xMajor ? xhi : yhi;
+    const int blo = xMajor ? ylo : xlo, bhi = xMajor ? yhi : xhi;
+    
+    // Visible range of steps [first, last] along the major axis
+    long long first = 0, last = major;
+    if (sa > 0) {
+        first = std::max(first, static_cast<long long>(alo) - a0);
+        last = std::min(last, static_cast<long long>(ahi) - a0);
+    } else {
+        first = std::max(first, static_cast<long long>(a0) - ahi);
+        last = std::min(last, static_cast<long long>(a0) - alo);
+    }
+    
+    // ...narrowed to the steps whose minor offset m lands in [mlo, mhi]
+    long long mlo = sb > 0 ? static_cast<long long>(blo) - b0 : static_cast<long long>(b0) - bhi;
+    long long mhi = sb > 0 ? static_cast<long long>(bhi) - b0 : static_cast<long long>(b0) - blo;
+    if (minor == 0) {
+        if (mlo > 0 || mhi < 0) return;
+    } else {
+        // m(i) >= k  <=>  i >= ceil((2 * major * k - major + 1) / (2 * minor))
+        first = std::max(first, ceilDiv(2 * major * mlo - major + 1, 2 * minor));
+        last = std::min(last, ceilDiv(2 * major * (mhi + 1) - major + 1, 2 * minor) - 1);
+    }
+    if (first > last) return;
+    
+    // Start the error-term walk at the first visible step
+    long long num = 2 * first * minor + major - 1;
+    long long m = major > 0 ? floorDiv(num, 2 * major) : 0;
+    long long rem = num - m * 2 * major;
+    int a = a0 + sa * static_cast<int>(first);
+    int b = b0 + sb * static_cast<int>(m);
+    
+    for (long long i = first; i <= last; i++) {
+        if (xMajor) plot(a, b); else plot(b, a);
+        
+        a += sa;
+        rem += 2 * minor;
+        if (rem >= 2 * major) {
+            rem -= 2 * major;
+            b += sb;
+        }
+    }
+}
+
+RasterFramebuffer::RasterFramebuffer(int w, int h, bool flip) : width(0), height(0), flipY(flip) {
+    resize(w, h);
+}
+
+void RasterFramebuffer::resize(int w, int h) {
+    width = std::max(w, 0);
+    height = std::max(h, 0);
+    pixels.resize(static_cast<size_t>(width) * height * 3, 0.0f);
+}
+
+void RasterFramebuffer::clear(const glm::vec3& color) {
+    fillRGB(pixels.data(), static_cast<size_t>(width) * height, color);
+}
+
+void RasterFramebuffer::setPixel(int x, int y, const glm::vec3& color) {
+    // Check if the pixel is within bounds
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return;
+    }
+    
+    float* p = pixelPtr(x, y);
+    p[0] = color.r;
+    p[1] = color.g;
+    p[2] = color.b;
+}
+
+void RasterFramebuffer::blendPixel(int x, int y, const glm::vec3& color, float alpha) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return;
+    }
+    
+    float* p = pixelPtr(x, y);
+    p[0] += (color.r - p[0]) * alpha;
+    p[1] += (color.g - p[1]) * alpha;
+    p[2] += (color.b - p[2]) * alpha;
+}
+
+int RasterFramebuffer::fillSpan(int y, int x0, int x1, const glm::vec3& color) {
+    // Clip the whole span once instead of testing every pixel
+    if (y < 0 || y >= height) {
+        return 0;
+    }
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, width);
+    if (x0 >= x1) {
+        return 0;
+    }
+    
+    fillRGB(pixelPtr(x0, y), x1 - x0, color);
+    return x1 - x0;
+}
+
+void RasterFramebuffer::drawLine(int x0, int y0, int x1, int y1, const glm::vec3& color, int radius) {
+    if (width == 0 || height == 0) {
+        return;
+    }
+    
+    if (radius <= 0) {
+        walkLine(x0, y0, x1, y1, 0, 0, width - 1, height - 1, [&](int x, int y) {
+            float* p = pixelPtr(x, y);
+            p[0] = color.r;
+            p[1] = color.g;
+            p[2] = color.b;
+        });
+        return;
+    }
+    
+    // Thick line: only line pixels within `radius` of the image can touch
+    // it. Record the x extent of those pixels on every row they occupy.
+    const int rows = height + 2 * radius;
+    std::vector<int> rowMin(rows, width + radius);
+    std::vector<int> rowMax(rows, -radius - 1);
+    int firstRow = rows, lastRow = -1;
+    walkLine(x0, y0, x1, y1, -radius, -radius, width - 1 + radius, height - 1 + radius, [&](int x, int y) {
+        int r = y + radius;
+        rowMin[r] = std::min(rowMin[r], x);
+        rowMax[r] = std::max(rowMax[r], x);
+        firstRow = std::min(firstRow, r);
+        lastRow = std::max(lastRow, r);
+    });
+    if (firstRow > lastRow) {
+        return;
+    }
+    
+    // Consecutive line pixels are at most one column apart, so the squares
+    // stamped by the line pixels within `radius` rows of y overlap into one
+    // span on row y: from their leftmost x - radius to rightmost x + radius
+    int yBegin = std::max(0, firstRow - 2 * radius);
+    int yEnd = std::min(height - 1, lastRow);
+    for (int y = yBegin; y <= yEnd; y++) {
+        int left = width + radius;
+        int right = -radius - 1;
+        for (int r = y; r <= y + 2 * radius; r++) {
+            left = std::min(left, rowMin[r]);
+            right = std::max(right, rowMax[r]);
+        }
+        if (left <= right) {
+            fillSpan(y, left - radius, right + radius + 1, color);
+        }
+    }
+}
+
+void RasterFramebuffer::blit(const RasterFramebuffer& src, int dstX, int dstY) {
+    // Clip the source rectangle against this image
+    int x0 = std::max(0, -dstX);
+    int x1 = std::min(src.width, width - dstX);
+    int y0 = std::max(0, -dstY);
+    int y1 = std::min(src.height, height - dstY);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    
+    // Rows are contiguous in both images whichever way they are stored
+    for (int y = y0; y < y1; y++) {
+        std::memcpy(pixelPtr(dstX + x0, dstY + y), src.pixelPtr(x0, y),
+                    static_cast<size_t>(x1 - x0) * 3 * sizeof(float));
+    }
+}
+
+bool ScanConverter::setupEdge(const glm::vec2& v1, const glm::vec2& v2, FillMode mode, Edge& edge) {
+    // Convert to fixed-point. Integer mode truncates to whole pixels first,
+    // like the original algorithm did.
+    int x1, y1, x2, y2;
+    if (mode != FILL_INTEGER) {
+        x1 = static_cast<int>(std::lround(v1.x * SUBPIXEL_SCALE));
+        y1 = static_cast<int>(std::lround(v1.y * SUBPIXEL_SCALE));
+        x2 = static_cast<int>(std::lround(v2.x * SUBPIXEL_SCALE));
+        y2 = static_cast<int>(std::lround(v2.y * SUBPIXEL_SCALE));
+    } else {
+        x1 = static_cast<int>(v1.x) * SUBPIXEL_SCALE;
+        y1 = static_cast<int>(v1.y) * SUBPIXEL_SCALE;
+        x2 = static_cast<int>(v2.x) * SUBPIXEL_SCALE;
+        y2 = static_cast<int>(v2.y) * SUBPIXEL_SCALE;
+    }
+    
+    // Skip horizontal edges (they don't cross a scanline)
+    if (y1 == y2) return false;
+    
+    // Ensure y1 <= y2 (top to bottom)
+    if (y1 > y2) {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+    }
+    
+    // The edge covers the scanlines whose sample row lies in [y1, y2), so a
+    // scanline through a shared vertex is counted by exactly one edge
+    const int shift = rowShift(mode);
+    const int rowSize = 1 << shift;
+    const int offset = sampleOffset(mode);
+    edge.ystart = (y1 - offset + rowSize - 1) >> shift;
+    edge.ymax = (y2 - offset + rowSize - 1) >> shift;
+    if (edge.ystart >= edge.ymax) return false;
+    
+    // Exact x on the first sample row, and the exact change per scanline,
+    // both as an integer part plus a remainder over the edge height
+    edge.dy = y2 - y1;
+    long long num = static_cast<long long>(edge.ystart * rowSize + offset - y1) * (x2 - x1);
+    long long q = floorDiv(num, edge.dy);
+    edge.x = x1 + static_cast<int>(q);
+    edge.xRem = static_cast<int>(num - q * edge.dy);
+    
+    num = static_cast<long long>(rowSize) * (x2 - x1);
+    q = floorDiv(num, edge.dy);
+    edge.dxInt = static_cast<int>(q);
+    edge.dxRem = static_cast<int>(num - q * edge.dy);
+    
+    edge.next = -1;
+    return true;
+}
+
+void ScanConverter::buildEdgeTable(const std::vector<glm::vec2>& vertices, FillMode mode, int height) {
+    // Reset the table; clear() and assign() keep the previous capacity
+    edges.clear();
+    edgeBuckets.clear();
+    
+    if (vertices.size() < 3) {
+        return; // Not enough vertices to form a polygon
+    }
+    
+    // Set up every edge and find the y bounds of the scanlines they cover.
+    // When anti-aliasing, rows are sub-scanlines.
+    const int rows = mode == FILL_ANTIALIASED ? height * AA_SUBSAMPLES : height;
+    ymin = rows;
+    ymax = -1;
+    int n = vertices.size();
+    
+    for (int i = 0; i < n; i++) {
+        Edge edge;
+        if (!setupEdge(vertices[i], vertices[(i + 1) % n], mode, edge)) continue;
+        
+        // Clip the edge to the framebuffer rows
+        if (edge.ystart < 0) {
+            edge.advance(-edge.ystart);
+            edge.ystart = 0;
+        }
+        edge.ymax = std::min(edge.ymax, rows);
+        if (edge.ystart >= edge.ymax) continue;
+        
+        ymin = std::min(ymin, edge.ystart);
+        ymax = std::max(ymax, edge.ymax - 1);
+        edges.push_back(edge);
+    }
+    
+    // Nothing to fill if the polygon lies entirely off screen
+    if (edges.empty()) {
+        return;
+    }
+    
+    // One bucket head per scanline of the polygon's y-range; link each edge
+    // into the bucket of its starting scanline
+    edgeBuckets.assign(ymax - ymin + 1, -1);
+    for (int e = 0; e < static_cast<int>(edges.size()); e++) {
+        edges[e].next = edgeBuckets[edges[e].ystart - ymin];
+        edgeBuckets[edges[e].ystart - ymin] = e;
+    }
+}
+
+void ScanConverter::fillPolygon(RasterFramebuffer& target, const std::vector<glm::vec2>& vertices,
+                                const glm::vec3& color, FillMode mode) {
+    // 1. Find ymin, ymax and 2. build the Sorted Edge Table (SET)
+    buildEdgeTable(vertices, mode, target.getHeight());
+    if (edgeBuckets.empty()) {
+        return;
+    }
+    
+    // Split [ymin, ymax] into bands of rows. Band boundaries are multiples of
+    // the band height so anti-aliased bands always hold whole pixel rows.
+    const int bandRows = mode == FILL_ANTIALIASED ? FILL_BAND_HEIGHT * AA_SUBSAMPLES : FILL_BAND_HEIGHT;
+    const int firstBand = ymin / bandRows;
+    const int lastBand = ymax / bandRows;
+    const int numBands = lastBand - firstBand + 1;
+    
+    // Small polygons are not worth starting threads for
+    int numThreads = 1;
+    if (numBands >= FILL_PARALLEL_MIN_BANDS) {
+        numThreads = std::min(numBands, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    }
+    
+    // Per-thread scratch buffers are kept between fills
+    if (static_cast<int>(bandScratch.size()) < numThreads) {
+        bandScratch.resize(numThreads);
+    }
+    
+    // Workers pull bands from a shared counter until none are left. Each band
+    // sets up its own AET, so bands can be filled in any order.
+    std::atomic<int> nextBand(firstBand);
+    auto fill_bands = [&](int thread) {
+        for (int band = nextBand++; band <= lastBand; band = nextBand++) {
+            int rowBegin = std::max(band * bandRows, ymin);
+            int rowEnd = std::min((band + 1) * bandRows, ymax + 1);
+            if (mode == FILL_ANTIALIASED) {
+                fillBandAntialiased(target, rowBegin, rowEnd, color, bandScratch[thread]);
+            } else {
+                fillBand(target, rowBegin, rowEnd, mode, color, bandScratch[thread]);
+            }
+        }
+    };
+    
+    if (numThreads == 1) {
+        fill_bands(0);
+    } else {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++) {
+            threads.emplace_back(fill_bands, t);
+        }
+        for (auto& t : threads) t.join();
+    }
+}
+
+void ScanConverter::initBandEdges(int rowBegin, std::vector<Edge>& activeEdges) const {
+    // Evaluate every edge that is already active on the band's first row
+    // directly at that row, instead of stepping it down from ymin. Edges
+    // starting inside the band come from the buckets as usual.
+    activeEdges.clear();
+    for (const Edge& e : edges) {
+        if (e.ystart < rowBegin && e.ymax > rowBegin) {
+            Edge edge = e;
+            edge.advance(rowBegin - e.ystart);
+            activeEdges.push_back(edge);
+        }
+    }
+}
+
+void ScanConverter::fillBand(RasterFramebuffer& target, int rowBegin, int rowEnd, FillMode mode,
+                             const glm::vec3& color, BandScratch& scratch) {
+    const int offset = sampleOffset(mode);
+    
+    // 3. Initialize Active Edge Table (AET) at the band's first scanline
+    std::vector<Edge>& activeEdges = scratch.active;
+    initBandEdges(rowBegin, activeEdges);
+    
+    // 4. For y = rowBegin to rowEnd - 1:
+    for (int y = rowBegin; y < rowEnd; y++) {
+        // a. Add edges from SET[y] to AET
+        for (int e = edgeBuckets[y - ymin]; e != -1; e = edges[e].next) {
+            activeEdges.push_back(edges[e]);
+        }
+        
+        // b. Remove edges from AET where y = ymax
+        activeEdges.erase(std::remove_if(activeEdges.begin(), activeEdges.end(),
+                                         [y](const Edge& edge) { return edge.ymax <= y; }),
+                          activeEdges.end());
+        
+        // c. Sort AET by x. The order barely changes between scanlines,
+        //    so insertion sort runs in close to linear time here.
+        for (size_t i = 1; i < activeEdges.size(); i++) {
+            Edge edge = activeEdges[i];
+            size_t j = i;
+            while (j > 0 && edge < activeEdges[j - 1]) {
+                activeEdges[j] = activeEdges[j - 1];
+                j--;
+            }
+            activeEdges[j] = edge;
+        }
+        
+        // d. For every pair of intersections in AET, fill the pixels whose
+        //    sample points lie between the pair
+        for (size_t i = 0; i + 1 < activeEdges.size(); i += 2) {
+            int x_start = activeEdges[i].pixelX(offset);
+            int x_end = activeEdges[i + 1].pixelX(offset);
+            
+            // Fill the span
+            target.fillSpan(y, x_start, x_end, color);
+        }
+        
+        // e. y is incremented in the for loop
+        
+        // f. Step x exactly using integer arithmetic
+        for (auto& edge : activeEdges) {
+            edge.step();
+        }
+    }
+}
+
+void ScanConverter::fillBandAntialiased(RasterFramebuffer& target, int rowBegin, int rowEnd,
+                                        const glm::vec3& color, BandScratch& scratch) {
+    // Same AET walk as fillBand, but along sub-scanlines. Every span adds
+    // its exact horizontal coverage to the cells of the current pixel row,
+    // which is resolved once all of its sub-scanlines are done.
+    const int width = target.getWidth();
+    const int maxX = width * SUBPIXEL_SCALE;
+    std::vector<int>& coverage = scratch.coverage;
+    coverage.assign(width + 2, 0);
+    int touchedMin = width + 1;
+    int touchedMax = -1;
+    
+    std::vector<Edge>& activeEdges = scratch.active;
+    initBandEdges(rowBegin, activeEdges);
+    
+    for (int row = rowBegin; row < rowEnd; row++) {
+        // Add edges starting on this sub-scanline and drop finished ones
+        for (int e = edgeBuckets[row - ymin]; e != -1; e = edges[e].next) {
+            activeEdges.push_back(edges[e]);
+        }
+        activeEdges.erase(std::remove_if(activeEdges.begin(), activeEdges.end(),
+                                         [row](const Edge& edge) { return edge.ymax <= row; }),
+                          activeEdges.end());
+        
+        // Insertion sort by x, as in fillBand
+        for (size_t i = 1; i < activeEdges.size(); i++) {
+            Edge edge = activeEdges[i];
+            size_t j = i;
+            while (j > 0 && edge < activeEdges[j - 1]) {
+                activeEdges[j] = activeEdges[j - 1];
+                j--;
+            }
+            activeEdges[j] = edge;
+        }
+        
+        // Accumulate the coverage of each span, clipped to the framebuffer
+        for (size_t i = 0; i + 1 < activeEdges.size(); i += 2) {
+            int x0 = std::max(activeEdges[i].x, 0);
+            int x1 = std::min(activeEdges[i + 1].x, maxX);
+            if (x0 < x1) {
+                accumulateSpan(coverage, x0, x1, touchedMin, touchedMax);
+            }
+        }
+        
+        // Resolve the pixel row after its last sub-scanline
+        if ((row & (AA_SUBSAMPLES - 1)) == AA_SUBSAMPLES - 1 || row == rowEnd - 1) {
+            if (touchedMin <= touchedMax) {
+                resolveCoverageRow(target, coverage, row >> AA_SUBSAMPLE_BITS, touchedMin, touchedMax, color);
+            }
+            touchedMin = width + 1;
+            touchedMax = -1;
+        }
+        
+        for (auto& edge : activeEdges) {
+            edge.step();
+        }
+    }
+}
+
+void ScanConverter::accumulateSpan(std::vector<int>& coverage, int x0, int x1, int& touchedMin, int& touchedMax) {
+    // Difference-array form of the span's coverage: the first pixel gets the
+    // part right of x0, the last pixel the part left of x1, and everything in
+    // between is fully covered. Four updates work whether or not both ends
+    // fall in the same pixel.
+    int px0 = x0 >> SUBPIXEL_BITS;
+    int px1 = x1 >> SUBPIXEL_BITS;
+    int f0 = x0 & (SUBPIXEL_SCALE - 1);
+    int f1 = x1 & (SUBPIXEL_SCALE - 1);
+    
+    coverage[px0] += SUBPIXEL_SCALE - f0;
+    coverage[px0 + 1] += f0;
+    coverage[px1] += f1 - SUBPIXEL_SCALE;
+    coverage[px1 + 1] -= f1;
+    
+    touchedMin = std::min(touchedMin, px0);
+    touchedMax = std::max(touchedMax, px1 + 1);
+}
+
+void ScanConverter::resolveCoverageRow(RasterFramebuffer& target, std::vector<int>& coverage, int y,
+                                       int touchedMin, int touchedMax, const glm::vec3& color) {
+    const int fullCoverage = SUBPIXEL_SCALE * AA_SUBSAMPLES;
+    int accumulated = 0;
+    
+    for (int x = touchedMin; x <= touchedMax; x++) {
+        accumulated += coverage[x];
+        coverage[x] = 0;
+        
+        if (accumulated >= fullCoverage) {
+            // Fully covered run: a plain solid span fill
+            int runStart = x;
+            while (x + 1 <= touchedMax && accumulated + coverage[x + 1] >= fullCoverage) {
+                x++;
+                accumulated += coverage[x];
+                coverage[x] = 0;
+            }
+            target.fillSpan(y, runStart, x + 1, color);
+        } else if (accumulated > 0) {
+            // Partially covered edge pixel
+            target.blendPixel(x, y, color, static_cast<float>(accumulated) / fullCoverage);
+        }
+    }
+}
+
+void ScanConverter::buildBatchEdgeTable(const PolygonBatch& polygons, FillMode mode, int height) {
+    const int numTiles = (height + BATCH_TILE_HEIGHT - 1) / BATCH_TILE_HEIGHT;
+    
+    // Reset the shared edge table; all containers keep their capacity
+    batchEdges.clear();
+    batchBuckets.assign(height, -1);
+    batchTileOffsets.assign(numTiles + 1, 0);
+    
+    for (int p = 0; p < polygons.size(); p++) {
+        int begin = polygons.polygonBegin(p);
+        int end = polygons.polygonEnd(p);
+        if (end - begin < 3) continue;
+        
+        for (int i = begin; i < end; i++) {
+            const glm::vec2& v1 = polygons.vertices[i];
+            const glm::vec2& v2 = polygons.vertices[i + 1 < end ? i + 1 : begin];
+            
+            BatchEdge edge;
+            if (!setupEdge(v1, v2, mode, edge)) continue;
+            edge.polygon = p;
+            edge.winding = v2.y > v1.y ? 1 : -1;
+            
+            // Clip the edge to the framebuffer rows
+            if (edge.ystart < 0) {
+                edge.advance(-edge.ystart);
+                edge.ystart = 0;
+            }
+            edge.ymax = std::min(edge.ymax, height);
+            if (edge.ystart >= edge.ymax) continue;
+            
+            // Link the edge into the bucket of its starting scanline
+            edge.next = batchBuckets[edge.ystart];
+            batchBuckets[edge.ystart] = static_cast<int>(batchEdges.size());
+            batchEdges.push_back(edge);
+            
+            // Count the edge in every later tile it is still active in
+            int firstTile = edge.ystart / BATCH_TILE_HEIGHT + 1;
+            int lastTile = (edge.ymax - 1) / BATCH_TILE_HEIGHT;
+            for (int t = firstTile; t <= lastTile; t++) {
+                batchTileOffsets[t + 1]++;
+            }
+        }
+    }
+    
+    // Turn the per-tile counts into offsets and scatter the edge indices
+    for (int t = 0; t < numTiles; t++) {
+        batchTileOffsets[t + 1] += batchTileOffsets[t];
+    }
+    batchTileEdges.resize(batchTileOffsets[numTiles]);
+    
+    for (int e = 0; e < static_cast<int>(batchEdges.size()); e++) {
+        const BatchEdge& edge = batchEdges[e];
+        int firstTile = edge.ystart / BATCH_TILE_HEIGHT + 1;
+        int lastTile = (edge.ymax - 1) / BATCH_TILE_HEIGHT;
+        for (int t = firstTile; t <= lastTile; t++) {
+            batchTileEdges[batchTileOffsets[t]++] = e;
+        }
+    }
+    
+    // The scatter advanced every offset to the start of the next tile
+    for (int t = numTiles; t > 0; t--) {
+        batchTileOffsets[t] = batchTileOffsets[t - 1];
+    }
+    batchTileOffsets[0] = 0;
+}
+
+long long ScanConverter::fillBatchTile(RasterFramebuffer& target, const PolygonBatch& polygons, int tile,
+                                       FillMode mode, BatchScratch& scratch) {
+    const int offset = sampleOffset(mode);
+    const int y0 = tile * BATCH_TILE_HEIGHT;
+    const int y1 = std::min(y0 + BATCH_TILE_HEIGHT, target.getHeight());
+    std::vector<BatchEdge>& active = scratch.active;
+    std::vector<BatchEdge>& incoming = scratch.incoming;
+    long long pixels = 0;
+    
+    // Edges that started in an earlier tile are evaluated directly at y0
+    active.clear();
+    for (int i = batchTileOffsets[tile]; i < batchTileOffsets[tile + 1]; i++) {
+        BatchEdge edge = batchEdges[batchTileEdges[i]];
+        edge.advance(y0 - edge.ystart);
+        active.push_back(edge);
+    }
+    std::sort(active.begin(), active.end());
+    
+    for (int y = y0; y < y1; y++) {
+        // Remove edges that end below this scanline
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [y](const BatchEdge& edge) { return edge.ymax <= y; }),
+                     active.end());
+        
+        // Stepping only swaps neighbours within a polygon, so insertion sort
+        // restores the (polygon, x) order in close to linear time
+        for (size_t i = 1; i < active.size(); i++) {
+            BatchEdge edge = active[i];
+            size_t j = i;
+            while (j > 0 && edge < active[j - 1]) {
+                active[j] = active[j - 1];
+                j--;
+            }
+            active[j] = edge;
+        }
+        
+        // Edges starting on this scanline are sorted on their own and merged
+        // in, rather than insertion-sorted through the whole AET
+        if (batchBuckets[y] != -1) {
+            incoming.clear();
+            for (int e = batchBuckets[y]; e != -1; e = batchEdges[e].next) {
+                incoming.push_back(batchEdges[e]);
+            }
+            std::sort(incoming.begin(), incoming.end());
+            
+            scratch.merged.resize(active.size() + incoming.size());
+            std::merge(active.begin(), active.end(), incoming.begin(), incoming.end(),
+                       scratch.merged.begin());
+            active.swap(scratch.merged);
+        }
+        
+        // Walk each polygon's crossings in paint order and fill its inside spans
+        size_t i = 0;
+        while (i < active.size()) {
+            const int polygon = active[i].polygon;
+            const glm::vec3& color = polygons.colors[polygon];
+            int winding = 0;
+            int spanStart = 0;
+            
+            for (; i < active.size() && active[i].polygon == polygon; i++) {
+                int x = active[i].pixelX(offset);
+                bool wasInside = winding != 0;
+                
+                if (polygons.fillRule == FILL_NON_ZERO) {
+                    winding += active[i].winding;
+                } else {
+                    winding ^= 1;
+                }
+                
+                bool inside = winding != 0;
+                if (!wasInside && inside) {
+                    spanStart = x;
+                } else if (wasInside && !inside) {
+                    pixels += target.fillSpan(y, spanStart, x, color);
+                }
+            }
+        }
+        
+        // Step every active edge to the next scanline
+        for (auto& edge : active) {
+            edge.step();
+        }
+    }
+    
+    return pixels;
+}
+
+BatchFillStats ScanConverter::fillPolygons(RasterFramebuffer& target, const PolygonBatch& polygons, FillMode mode) {
+    auto start = std::chrono::steady_clock::now();
+    
+    // Batches are not anti-aliased; that mode fills them at subpixel precision
+    if (mode == FILL_ANTIALIASED) {
+        mode = FILL_SUBPIXEL;
+    }
+    buildBatchEdgeTable(polygons, mode, target.getHeight());
+    
+    const int numTiles = (target.getHeight() + BATCH_TILE_HEIGHT - 1) / BATCH_TILE_HEIGHT;
+    const int numThreads = std::max(1, std::min(numTiles, static_cast<int>(std::thread::hardware_concurrency())));
+    
+    // Per-thread scratch buffers are kept between fills
+    if (static_cast<int>(batchScratch.size()) < numThreads) {
+        batchScratch.resize(numThreads);
+    }
+    
+    // Workers pull tiles from a shared counter until none are left
+    std::atomic<int> nextTile(0);
+    std::atomic<long long> totalPixels(0);
+    auto fill_tiles = [&](int thread) {
+        long long pixels = 0;
+        for (int tile = nextTile++; tile < numTiles; tile = nextTile++) {
+            pixels += fillBatchTile(target, polygons, tile, mode, batchScratch[thread]);
+        }
+        totalPixels += pixels;
+    };
+    
+    if (numThreads == 1) {
+        fill_tiles(0);
+    } else {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++) {
+            threads.emplace_back(fill_tiles, t);
+        }
+        for (auto& t : threads) t.join();
+    }
+    
+    BatchFillStats stats;
+    stats.polygons = polygons.size();
+    stats.pixels = totalPixels;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
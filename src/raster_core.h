@@ -0,0 +1,253 @@
+#ifndef RASTER_CORE_H
+#define RASTER_CORE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// GL-free 2D raster core shared by the line rasterizer and the scan-line
+// renderer: a float RGB framebuffer with clipped spans, lines and blits, and
+// a scan converter for single polygons and polygon batches. The renderers
+// only add the OpenGL texture upload and display on top.
+
+// Vertex coordinates are converted to fixed point with 8 fractional bits
+const int SUBPIXEL_BITS = 8;
+const int SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+
+// Anti-aliased fills step edges along 2^4 = 16 sub-scanlines per pixel row
+const int AA_SUBSAMPLE_BITS = 4;
+const int AA_SUBSAMPLES = 1 << AA_SUBSAMPLE_BITS;
+
+// How polygon vertices are placed on the pixel grid
+enum FillMode {
+    FILL_INTEGER,       // Vertices snap to whole pixels, samples at pixel corners
+    FILL_SUBPIXEL,      // Vertices keep subpixel precision, samples at pixel centers
+    FILL_ANTIALIASED    // Subpixel vertices, edge pixels blended by their coverage
+};
+
+// Edge structure for the scan-line algorithm. x is stepped exactly: the
+// integer part is in subpixel units and the fraction is kept as a remainder
+// over the edge height, so long edges never drift. Edges live in one flat
+// array and are chained into per-scanline buckets by index.
+struct Edge {
+    int ystart;     // First scanline whose sample row the edge crosses
+    int ymax;       // First scanline past the end of the edge
+    int x;          // Current x, integer part (subpixel units)
+    int xRem;       // Fractional part of x, as a numerator over dy (0 <= xRem < dy)
+    int dxInt;      // Integer part of the change in x per scanline
+    int dxRem;      // Fractional part of the change in x per scanline, over dy
+    int dy;         // Height of the edge in subpixel units
+    int next;       // Index of the next edge in the same bucket (-1 ends the chain)
+    
+    // Move to the next scanline
+    void step() {
+        x += dxInt;
+        xRem += dxRem;
+        if (xRem >= dy) {
+            x++;
+            xRem -= dy;
+        }
+    }
+    
+    // Move down by several scanlines at once, with the same result as stepping
+    void advance(int rows) {
+        long long rem = xRem + static_cast<long long>(dxRem) * rows;
+        x += dxInt * rows + static_cast<int>(rem / dy);
+        xRem = static_cast<int>(rem % dy);
+    }
+    
+    // First pixel whose sample point lies at or to the right of the edge.
+    // Spans cover [left.pixelX, right.pixelX), so a pixel whose sample sits
+    // exactly on a shared edge goes to the polygon on its right only.
+    int pixelX(int sampleOffset) const {
+        int q = x - sampleOffset;
+        return xRem == 0 ? (q + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS : (q >> SUBPIXEL_BITS) + 1;
+    }
+    
+    // Comparison operator for sorting edges by their exact x coordinate
+    bool operator<(const Edge& other) const {
+        if (x != other.x) return x < other.x;
+        return static_cast<long long>(xRem) * other.dy < static_cast<long long>(other.xRem) * dy;
+    }
+};
+
+// Edge of a polygon in a batch fill. ystart lets a tile evaluate the edge at
+// any y with advance() instead of stepping it from its first scanline.
+struct BatchEdge : Edge {
+    int polygon;    // Index of the owning polygon, which is also its paint order
+    int winding;    // +1 for edges going up in y, -1 for edges going down
+    
+    // Active edges are grouped by polygon, then sorted by x
+    bool operator<(const BatchEdge& other) const {
+        return polygon != other.polygon ? polygon < other.polygon : Edge::operator<(other);
+    }
+};
+
+// Rule deciding which spans between edge crossings are inside a polygon
+enum FillRule {
+    FILL_EVEN_ODD,
+    FILL_NON_ZERO
+};
+
+// A set of polygons that are scan-converted together. The vertices of all
+// polygons are stored back to back; polygonStarts[i] is the first vertex of
+// polygon i. Later polygons are painted over earlier ones.
+struct PolygonBatch {
+    std::vector<glm::vec2> vertices;
+    std::vector<int> polygonStarts;
+    std::vector<glm::vec3> colors;
+    FillRule fillRule = FILL_EVEN_ODD;
+    
+    void clear() {
+        vertices.clear();
+        polygonStarts.clear();
+        colors.clear();
+    }
+    
+    void addPolygon(const std::vector<glm::vec2>& polygon, const glm::vec3& color) {
+        polygonStarts.push_back(static_cast<int>(vertices.size()));
+        vertices.insert(vertices.end(), polygon.begin(), polygon.end());
+        colors.push_back(color);
+    }
+    
+    int size() const { return static_cast<int>(polygonStarts.size()); }
+    bool empty() const { return polygonStarts.empty(); }
+    
+    // Vertex range [begin, end) of polygon i
+    int polygonBegin(int i) const { return polygonStarts[i]; }
+    int polygonEnd(int i) const {
+        return i + 1 < size() ? polygonStarts[i + 1] : static_cast<int>(vertices.size());
+    }
+};
+
+// Throughput of the most recent batch fill
+struct BatchFillStats {
+    int polygons = 0;
+    long long pixels = 0;
+    double milliseconds = 0.0;
+    
+    double polygonsPerSecond() const { return milliseconds > 0.0 ? polygons * 1000.0 / milliseconds : 0.0; }
+    double pixelsPerSecond() const { return milliseconds > 0.0 ? pixels * 1000.0 / milliseconds : 0.0; }
+};
+
+// Float RGB image with y = 0 as the first scanline. With flipY set, rows are
+// stored bottom-up so the buffer can be uploaded as an OpenGL texture as is.
+// Every drawing method clips to the image; none of them touch shared state,
+// so worker threads may draw into disjoint rows at the same time.
+class RasterFramebuffer {
+private:
+    int width, height;
+    bool flipY;
+    std::vector<float> pixels;
+
+public:
+    RasterFramebuffer(int w = 0, int h = 0, bool flip = false);
+    
+    void resize(int w, int h);
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const float* data() const { return pixels.data(); }
+    
+    // Address of pixel (x, y); the caller checks the bounds
+    float* pixelPtr(int x, int y) {
+        return &pixels[(static_cast<size_t>(flipY ? height - 1 - y : y) * width + x) * 3];
+    }
+    const float* pixelPtr(int x, int y) const {
+        return &pixels[(static_cast<size_t>(flipY ? height - 1 - y : y) * width + x) * 3];
+    }
+    
+    // Fill the whole image with one color
+    void clear(const glm::vec3& color);
+    
+    // Single pixels; blendPixel mixes the color in with the given opacity
+    void setPixel(int x, int y, const glm::vec3& color);
+    void blendPixel(int x, int y, const glm::vec3& color, float alpha);
+    
+    // Fill pixels [x0, x1) of scanline y; returns the number of pixels written
+    int fillSpan(int y, int x0, int x1, const glm::vec3& color);
+    
+    // Bresenham line between two pixel centers, both inclusive. The line is
+    // clipped before it is walked, so only its visible pixels cost anything.
+    // A radius above zero stamps a (2 * radius + 1)^2 square on every pixel
+    // of the line, drawn as one span per row.
+    void drawLine(int x0, int y0, int x1, int y1, const glm::vec3& color, int radius = 0);
+    
+    // Copy all of src with its top-left corner at (dstX, dstY)
+    void blit(const RasterFramebuffer& src, int dstX, int dstY);
+};
+
+// Scan converter for single polygons and polygon batches. It owns the edge
+// tables and per-thread scratch buffers, which keep their capacity between
+// fills, so refilling a polygon of the same size does not allocate.
+class ScanConverter {
+private:
+    // Edge table for the single polygon fill: flat edge storage plus one
+    // bucket head per scanline in [ymin, ymax]
+    std::vector<Edge> edges;
+    std::vector<int> edgeBuckets;
+    int ymin, ymax;
+    
+    // Per-thread scratch for single polygon fills: the band's active edge
+    // table, kept sorted by x with an insertion sort, and the coverage cells
+    // of anti-aliased fills (a difference array over the pixels of one row,
+    // in units of 1/256 pixel per sub-scanline; only the touched range is
+    // read back and reset after each row)
+    struct BandScratch {
+        std::vector<Edge> active;
+        std::vector<int> coverage;
+    };
+    std::vector<BandScratch> bandScratch;
+    
+    // Per-thread scratch for batch fills: the AET, the edges entering on the
+    // current scanline, and a buffer the two are merged into
+    struct BatchScratch {
+        std::vector<BatchEdge> active;
+        std::vector<BatchEdge> incoming;
+        std::vector<BatchEdge> merged;
+    };
+    
+    // Batch edge table (one bucket per framebuffer row), the edges carried
+    // into each tile from the tiles above it (offsets + indices), and
+    // scratch for each worker
+    std::vector<BatchEdge> batchEdges;
+    std::vector<int> batchBuckets;
+    std::vector<int> batchTileOffsets;
+    std::vector<int> batchTileEdges;
+    std::vector<BatchScratch> batchScratch;
+    
+    // Edges are stepped along rows of 2^rowShift subpixel units: whole pixel
+    // rows, or sub-scanlines when anti-aliasing. Samples sit at the start or
+    // the middle of each row.
+    static int rowShift(FillMode mode) { return mode == FILL_ANTIALIASED ? SUBPIXEL_BITS - AA_SUBSAMPLE_BITS : SUBPIXEL_BITS; }
+    static int sampleOffset(FillMode mode) { return mode == FILL_INTEGER ? 0 : (1 << rowShift(mode)) / 2; }
+    static bool setupEdge(const glm::vec2& v1, const glm::vec2& v2, FillMode mode, Edge& edge);
+    
+    // Single polygon fill. Bands of rows [rowBegin, rowEnd) share the edge
+    // table and write disjoint rows, so they can run on worker threads.
+    void buildEdgeTable(const std::vector<glm::vec2>& vertices, FillMode mode, int height);
+    void initBandEdges(int rowBegin, std::vector<Edge>& activeEdges) const;
+    void fillBand(RasterFramebuffer& target, int rowBegin, int rowEnd, FillMode mode,
+                  const glm::vec3& color, BandScratch& scratch);
+    void fillBandAntialiased(RasterFramebuffer& target, int rowBegin, int rowEnd,
+                             const glm::vec3& color, BandScratch& scratch);
+    static void accumulateSpan(std::vector<int>& coverage, int x0, int x1, int& touchedMin, int& touchedMax);
+    static void resolveCoverageRow(RasterFramebuffer& target, std::vector<int>& coverage, int y,
+                                   int touchedMin, int touchedMax, const glm::vec3& color);
+    
+    // Batch fill
+    void buildBatchEdgeTable(const PolygonBatch& polygons, FillMode mode, int height);
+    long long fillBatchTile(RasterFramebuffer& target, const PolygonBatch& polygons, int tile,
+                            FillMode mode, BatchScratch& scratch);
+
+public:
+    // Fill one polygon (even-odd rule), splitting large polygons into bands
+    // of rows that are filled in parallel
+    void fillPolygon(RasterFramebuffer& target, const std::vector<glm::vec2>& vertices,
+                     const glm::vec3& color, FillMode mode);
+    
+    // Scan-convert a whole batch of polygons, splitting the image into tiles
+    // of rows that are filled in parallel. Batches are not anti-aliased; that
+    // mode fills them at subpixel precision.
+    BatchFillStats fillPolygons(RasterFramebuffer& target, const PolygonBatch& polygons, FillMode mode);
+};
+
+#endif // RASTER_CORE_H
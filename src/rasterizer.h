@@ -4,6 +4,8 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include "canvas_display.h"
+#include "raster_core.h"
 
 class Rasterizer {
 private:
@@ -14,33 +16,24 @@ private:
     glm::vec2 startPoint, endPoint;
     glm::vec3 lineColor;
     
-    // Framebuffer objects
-    GLuint framebufferFBO;
-    GLuint framebufferTexture;
-    
     // Add these new members
-    std::vector<float> frameBuffer;
+    RasterFramebuffer frameBuffer;
     bool framebufferDirty;
     
-    // Display objects
-    GLuint quadVAO, quadVBO;
-    GLuint displayShader;
+    // Input revision: bumped whenever the line or the canvas changes.
+    // update() skips all raster work while the drawn revision is current.
+    unsigned int revision;
+    unsigned int drawnRevision;
     
-    // Setup methods
-    void setupFramebuffer();
-    void setupQuad();
-    void setupShaders();
+    // Texture, quad and shader the canvas is shown with
+    CanvasDisplay display;
     
     // Line drawing algorithms
     void basicLineRasterization(int x0, int y0, int x1, int y1);
     void bresenhamLine(int x0, int y0, int x1, int y1);
     
-    // Add this new method
-    void updateFramebuffer();
-    
 public:
     Rasterizer(int width, int height);
-    ~Rasterizer();
     
     void resize(int width, int height);
     void setPixel(int x, int y, const glm::vec3& color);
@@ -55,9 +48,15 @@ public:
     const glm::vec2& getEndPoint() const { return endPoint; }
     const glm::vec3& getLineColor() const { return lineColor; }
     
-    void setStartPoint(const glm::vec2& start) { startPoint = start; }
-    void setEndPoint(const glm::vec2& end) { endPoint = end; }
-    void setLineColor(const glm::vec3& color) { lineColor = color; }
+    void setStartPoint(const glm::vec2& start) {
+        if (start != startPoint) { startPoint = start; revision++; }
+    }
+    void setEndPoint(const glm::vec2& end) {
+        if (end != endPoint) { endPoint = end; revision++; }
+    }
+    void setLineColor(const glm::vec3& color) {
+        if (color != lineColor) { lineColor = color; revision++; }
+    }
 };
 
 #endif // RASTERIZER_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "raytracer.h"
+#include "profiler.h"
 #include "math_utils.h"
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
@@ -7,36 +8,26 @@
 #include <mutex>
 #include <cmath>
 
-// Shader sources for displaying the framebuffer
-const char* raytraceVertexShaderSource = R"(
-    #version 430 core
-    layout (location = 0) in vec2 aPos;
-    layout (location = 1) in vec2 aTexCoord;
-    
-    out vec2 TexCoord;
-    
-    void main() {
-        gl_Position = vec4(aPos, 0.0, 1.0);
-        TexCoord = aTexCoord;
-    }
-)";
-
-const char* raytraceFragmentShaderSource = R"(
-    #version 430 core
-    in vec2 TexCoord;
-    
-    out vec4 FragColor;
-    
-    uniform sampler2D screenTexture;
-    
-    void main() {
-        FragColor = texture(screenTexture, TexCoord);
-    }
-)";
+// Counters of the calling thread; trace() resets them on each worker and
+// adds them to the frame's statistics when the worker is done
+static thread_local RayStats rayCounters = RayStats();
+
+void RayStats::add(const RayStats& other) {
+    primaryRays += other.primaryRays;
+    shadowRays += other.shadowRays;
+    reflectionRays += other.reflectionRays;
+    sphereTests += other.sphereTests;
+    cubeTests += other.cubeTests;
+    meshTests += other.meshTests;
+    triangleTests += other.triangleTests;
+    nodeVisits += other.nodeVisits;
+    maxPixelCost = std::max(maxPixelCost, other.maxPixelCost);
+}
 
 // Sphere intersection implementation
 RayHit Sphere::intersect(const Ray& ray) const {
     RayHit hit;
+    rayCounters.sphereTests++;
     
     // Vector from ray origin to sphere center
     glm::vec3 oc = ray.origin - position;
@@ -72,6 +63,7 @@ RayHit Sphere::intersect(const Ray& ray) const {
 // Cube intersection implementation
 RayHit Cube::intersect(const Ray& ray) const {
     RayHit hit;
+    rayCounters.cubeTests++;
     
     // Transform ray to object space
     glm::mat4 invRotation = glm::inverse(rotation);
@@ -156,59 +148,132 @@ RayHit Cube::intersect(const Ray& ray) const {
     return hit;
 }
 
+// Möller–Trumbore ray-triangle intersection; t is the distance along the ray
+static bool intersectTriangle(const Ray& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t) {
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    glm::vec3 h = glm::cross(ray.direction, edge2);
+    float a = glm::dot(edge1, h);
+    
+    // If ray is parallel to triangle
+    if (a > -1e-5 && a < 1e-5) return false;
+    
+    float f = 1.0f / a;
+    glm::vec3 s = ray.origin - v0;
+    float u = f * glm::dot(s, h);
+    
+    // Check if intersection is outside triangle
+    if (u < 0.0f || u > 1.0f) return false;
+    
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = f * glm::dot(ray.direction, q);
+    
+    // Check if intersection is outside triangle
+    if (v < 0.0f || u + v > 1.0f) return false;
+    
+    // Compute distance to intersection
+    t = f * glm::dot(edge2, q);
+    return true;
+}
+
+// Slab test: does the ray enter the box before maxDistance?
+static bool intersectBox(const Ray& ray, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDistance) {
+    glm::vec3 inv = 1.0f / ray.direction;
+    glm::vec3 t0 = (boxMin - ray.origin) * inv;
+    glm::vec3 t1 = (boxMax - ray.origin) * inv;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return enter <= exit;
+}
+
 // Mesh intersection implementation
 RayHit MeshObject::intersect(const Ray& ray) const {
     RayHit hit;
-    
-    for (const auto& triangle : triangles) {
-        // Transform triangle vertices to world space
-        glm::vec3 v0 = triangle.v0.position + position;
-        glm::vec3 v1 = triangle.v1.position + position;
-        glm::vec3 v2 = triangle.v2.position + position;
-        
-        // Möller–Trumbore algorithm for ray-triangle intersection
-        glm::vec3 edge1 = v1 - v0;
-        glm::vec3 edge2 = v2 - v0;
-        glm::vec3 h = glm::cross(ray.direction, edge2);
-        float a = glm::dot(edge1, h);
-        
-        // If ray is parallel to triangle
-        if (a > -1e-5 && a < 1e-5) continue;
-        
-        float f = 1.0f / a;
-        glm::vec3 s = ray.origin - v0;
-        float u = f * glm::dot(s, h);
-        
-        // Check if intersection is outside triangle
-        if (u < 0.0f || u > 1.0f) continue;
-        
-        glm::vec3 q = glm::cross(s, edge1);
-        float v = f * glm::dot(ray.direction, q);
-        
-        // Check if intersection is outside triangle
-        if (v < 0.0f || u + v > 1.0f) continue;
-        
-        // Compute distance to intersection
-        float t = f * glm::dot(edge2, q);
-        
-        // Check if intersection is behind the ray or farther than current closest
-        if (t < 1e-5 || t > hit.distance) continue;
-        
-        // Valid intersection
-        hit.hit = true;
-        hit.distance = t;
-        hit.point = ray.origin + t * ray.direction;
-        
-        // Compute normal - use the triangle normal or interpolate vertex normals
-        hit.normal = glm::normalize(glm::cross(edge1, edge2));
+    rayCounters.meshTests++;
+    
+    // Without clusters the whole mesh is one range
+    size_t ranges = clusters.empty() ? 1 : clusters.size();
+    for (size_t c = 0; c < ranges; c++) {
+        size_t first = 0, last = triangles.size();
+        if (!clusters.empty()) {
+            const MeshCluster& cluster = clusters[c];
+            rayCounters.nodeVisits++;
+            if (!intersectBox(ray, cluster.boundsMin + position, cluster.boundsMax + position, hit.distance)) continue;
+            first = cluster.indexOffset / 3;
+            last = first + cluster.indexCount / 3;
+        }
+        rayCounters.triangleTests += last - first;
         
-        // Set material
-        hit.material = material;
+        for (size_t i = first; i < last; i++) {
+            const Triangle& triangle = triangles[i];
+            
+            // Transform triangle vertices to world space
+            glm::vec3 v0 = triangle.v0.position + position;
+            glm::vec3 v1 = triangle.v1.position + position;
+            glm::vec3 v2 = triangle.v2.position + position;
+            
+            float t;
+            if (!intersectTriangle(ray, v0, v1, v2, t)) continue;
+            
+            // Check if intersection is behind the ray or farther than current closest
+            if (t < 1e-5 || t > hit.distance) continue;
+            
+            // Valid intersection
+            hit.hit = true;
+            hit.distance = t;
+            hit.point = ray.origin + t * ray.direction;
+            
+            // Compute normal - use the triangle normal or interpolate vertex normals
+            hit.normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+            
+            // Set material
+            hit.material = material;
+        }
     }
     
     return hit;
 }
 
+bool Object::occludes(const Ray& ray, float maxDistance) const {
+    RayHit hit = intersect(ray);
+    return hit.hit && hit.distance < maxDistance;
+}
+
+// Any hit against the shadow level of detail ends the search
+bool MeshObject::occludes(const Ray& ray, float maxDistance) const {
+    const bool coarse = !shadowTriangles.empty();
+    const std::vector<Triangle>& tris = coarse ? shadowTriangles : triangles;
+    const std::vector<MeshCluster>& clus = coarse ? shadowClusters : clusters;
+    float minDistance = std::max(1e-5f, shadowBias);
+    rayCounters.meshTests++;
+    
+    size_t ranges = clus.empty() ? 1 : clus.size();
+    for (size_t c = 0; c < ranges; c++) {
+        size_t first = 0, last = tris.size();
+        if (!clus.empty()) {
+            rayCounters.nodeVisits++;
+            if (!intersectBox(ray, clus[c].boundsMin + position, clus[c].boundsMax + position, maxDistance)) continue;
+            first = clus[c].indexOffset / 3;
+            last = first + clus[c].indexCount / 3;
+        }
+        
+        for (size_t i = first; i < last; i++) {
+            const Triangle& triangle = tris[i];
+            float t;
+            if (intersectTriangle(ray, triangle.v0.position + position, triangle.v1.position + position,
+                                  triangle.v2.position + position, t) &&
+                t >= minDistance && t < maxDistance) {
+                rayCounters.triangleTests += i - first + 1;
+                return true;
+            }
+        }
+        rayCounters.triangleTests += last - first;
+    }
+    return false;
+}
+
 // Camera ray generation
 Ray Camera::generateRay(float x, float y) const {
     // Convert to NDC space
@@ -237,7 +302,9 @@ Ray Camera::generateRay(float x, float y) const {
 // --- SOFTWARE FRAMEBUFFER ---
 
 RayTracer::RayTracer(int w, int h)
-    : width(w), height(h), framebufferDirty(true), debugShadowView(false) // Initialize debugShadowView
+    : width(w), height(h), display("RayTracer::render", w, h), framebufferDirty(true),
+      debugShadowView(false), // Initialize debugShadowView
+      shadowLod(2), heatmapView(false), stats(RayStats())
 {
     maxDepth = 3;
     enableShadows = true;
@@ -248,119 +315,16 @@ RayTracer::RayTracer(int w, int h)
                     45.0f,
                     static_cast<float>(width) / static_cast<float>(height));
     frameBuffer.resize(width * height, glm::vec3(0.0f));
-    setupFramebuffer();
-    setupQuad();
-    setupShaders();
-}
-
-RayTracer::~RayTracer() {
-    glDeleteTextures(1, &framebufferTexture);
-    glDeleteFramebuffers(1, &framebufferFBO);
-    glDeleteVertexArrays(1, &quadVAO);
-    glDeleteBuffers(1, &quadVBO);
-    glDeleteProgram(displayShader);
-}
-
-void RayTracer::setupFramebuffer() {
-    glGenTextures(1, &framebufferTexture);
-    glBindTexture(GL_TEXTURE_2D, framebufferTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    glGenFramebuffers(1, &framebufferFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebufferFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebufferTexture, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
-void RayTracer::setupQuad() {
-    // Create a quad for displaying the framebuffer
-    float quadVertices[] = {
-        // Positions     // Texture Coords
-        -1.0f,  1.0f,    0.0f, 1.0f,
-        -1.0f, -1.0f,    0.0f, 0.0f,
-         1.0f, -1.0f,    1.0f, 0.0f,
-        
-        -1.0f,  1.0f,    0.0f, 1.0f,
-         1.0f, -1.0f,    0.0f, 0.0f,
-         1.0f,  1.0f,    1.0f, 1.0f
-    };
-    
-    // Create VAO and VBO
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    
-    glBindVertexArray(quadVAO);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    
-    // Position attribute
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    
-    // Texture coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    
-    glBindVertexArray(0);
-}
-
-void RayTracer::setupShaders() {
-    // Create and compile shaders
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &raytraceVertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    
-    // Check for vertex shader compilation errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "Vertex shader compilation failed: " << infoLog << std::endl;
-    }
-    
-    // Fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &raytraceFragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    
-    // Check for fragment shader compilation errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "Fragment shader compilation failed: " << infoLog << std::endl;
-    }
-    
-    // Create shader program
-    displayShader = glCreateProgram();
-    glAttachShader(displayShader, vertexShader);
-    glAttachShader(displayShader, fragmentShader);
-    glLinkProgram(displayShader);
-    
-    // Check for linking errors
-    glGetProgramiv(displayShader, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(displayShader, 512, NULL, infoLog);
-        std::cerr << "Shader program linking failed: " << infoLog << std::endl;
-    }
-    
-    // Delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    pixelCost.resize(width * height, 0);
 }
 
 void RayTracer::resize(int w, int h) {
     width = w; height = h;
     frameBuffer.resize(width * height, glm::vec3(0.0f));
+    pixelCost.resize(width * height, 0);
     framebufferDirty = true;
     camera.setAspectRatio(static_cast<float>(width) / static_cast<float>(height));
-    glBindTexture(GL_TEXTURE_2D, framebufferTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    display.resize(width, height);
 }
 
 void RayTracer::setPixel(int x, int y, const glm::vec3& color) {
@@ -369,15 +333,6 @@ void RayTracer::setPixel(int x, int y, const glm::vec3& color) {
     framebufferDirty = true;
 }
 
-void RayTracer::updateFramebuffer() {
-    if (framebufferDirty) {
-        glBindTexture(GL_TEXTURE_2D, framebufferTexture);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_FLOAT, frameBuffer.data());
-        glBindTexture(GL_TEXTURE_2D, 0);
-        framebufferDirty = false;
-    }
-}
-
 // --- RAY TRACING ALGORITHMS ---
 
 RayHit RayTracer::findClosestIntersection(const Ray& ray) {
@@ -398,9 +353,9 @@ bool RayTracer::isInShadow(const glm::vec3& point, const Light& light) {
     float dist = glm::length(lightDir);
     lightDir = glm::normalize(lightDir);
     Ray shadowRay(point + 0.001f * lightDir, lightDir);
+    rayCounters.shadowRays++;
     for (const auto& obj : objects) {
-        RayHit hit = obj->intersect(shadowRay);
-        if (hit.hit && hit.distance < dist) return true;
+        if (obj->occludes(shadowRay, dist)) return true;
     }
     return false;
 }
@@ -440,6 +395,7 @@ glm::vec3 RayTracer::traceRay(const Ray& ray, int depth) {
     if (enableReflections && reflectivity > 0.0f) {
         glm::vec3 reflectDir = glm::reflect(ray.direction, hit.normal);
         Ray reflectionRay(hit.point + 0.001f * reflectDir, reflectDir);
+        rayCounters.reflectionRays++;
         glm::vec3 reflectionColor = traceRay(reflectionRay, depth - 1);
         color = color * (1.0f - reflectivity) + reflectionColor * reflectivity;
     }
@@ -447,28 +403,67 @@ glm::vec3 RayTracer::traceRay(const Ray& ray, int depth) {
     return color;
 }
 
+// Blue through green to red for t in [0, 1]
+static glm::vec3 heatmapColor(float t) {
+    glm::vec3 cold(0.0f, 0.0f, 1.0f), warm(0.0f, 1.0f, 0.0f), hot(1.0f, 0.0f, 0.0f);
+    return t < 0.5f ? glm::mix(cold, warm, t * 2.0f) : glm::mix(warm, hot, t * 2.0f - 1.0f);
+}
+
 void RayTracer::trace() {
+    PROFILE_SCOPE("RayTracer::trace");
+    
+    double uploadTime = stats.uploadTime;
+    stats = RayStats();
+    stats.uploadTime = uploadTime;
     if (objects.empty() || lights.empty()) return;
+    int64_t traceStart = Profiler::now();
     const int numThreads = std::max(1u, std::thread::hardware_concurrency());
     std::vector<std::thread> threads;
     std::mutex mtx;
-    auto trace_section = [this, &mtx](int y0, int y1) {
+    auto trace_section = [this, &mtx](int y0, int y1, int tile) {
+        PROFILE_SCOPE_ARG("trace rows", "tile", tile);
+        int64_t start = Profiler::now();
+        rayCounters = RayStats();
         for (int y = y0; y < y1; ++y) for (int x = 0; x < width; ++x) {
             float u = (x + 0.5f) / float(width);
             float v = (y + 0.5f) / float(height);
             Ray ray = camera.generateRay(u, v);
+            rayCounters.primaryRays++;
+            uint64_t testsBefore = rayCounters.getTests();
             glm::vec3 color = traceRay(ray, maxDepth);
+            uint32_t cost = static_cast<uint32_t>(rayCounters.getTests() - testsBefore);
+            rayCounters.maxPixelCost = std::max(rayCounters.maxPixelCost, cost);
             std::lock_guard<std::mutex> lock(mtx);
+            pixelCost[y * width + x] = cost;
             setPixel(x, y, color);
         }
+        
+        double time = (Profiler::now() - start) / 1e6;
+        std::lock_guard<std::mutex> lock(mtx);
+        stats.add(rayCounters);
+        stats.threadTime += time;
+        stats.slowestThreadTime = std::max(stats.slowestThreadTime, time);
     };
     int rowsPerThread = height / numThreads;
     for (int i = 0; i < int(numThreads); ++i) {
         int y0 = i * rowsPerThread;
         int y1 = (i == numThreads - 1) ? height : (i + 1) * rowsPerThread;
-        threads.emplace_back(trace_section, y0, y1);
+        threads.emplace_back(trace_section, y0, y1, i);
     }
     for (auto& t : threads) t.join();
+    
+    // Costs span orders of magnitude between background and reflective
+    // mesh pixels, so the colors follow their logarithm
+    if (heatmapView) {
+        int64_t heatmapStart = Profiler::now();
+        float scale = 1.0f / std::log(1.0f + std::max(stats.maxPixelCost, 1u));
+        for (size_t i = 0; i < frameBuffer.size(); i++) {
+            frameBuffer[i] = heatmapColor(std::log(1.0f + pixelCost[i]) * scale);
+        }
+        framebufferDirty = true;
+        stats.heatmapTime = (Profiler::now() - heatmapStart) / 1e6;
+    }
+    stats.traceTime = (Profiler::now() - traceStart) / 1e6;
 }
 
 void RayTracer::clear(const glm::vec3& color) {
@@ -485,7 +480,19 @@ void RayTracer::addCube(const glm::vec3& pos, const glm::vec3& size, const Mater
 }
 
 void RayTracer::addMesh(const glm::vec3& pos, const Mesh* mesh, const Material& mat) {
-    objects.push_back(std::make_shared<MeshObject>(pos, mesh->getTriangles(), mat));
+    // Shadow rays only need the silhouette, so they use a coarser level of
+    // detail. Its surface may sit up to the simplification error on either
+    // side of the full one, which the bias keeps from shadowing itself.
+    // Both levels bring their clusters as a coarse acceleration structure.
+    int level = std::min(shadowLod, mesh->getLodCount() - 1);
+    if (level <= 0) {
+        objects.push_back(std::make_shared<MeshObject>(pos, mesh->getTriangles(), mesh->getLodClusters(0), mat,
+                                                       std::vector<Triangle>(), std::vector<MeshCluster>(), 0.0f));
+        return;
+    }
+    objects.push_back(std::make_shared<MeshObject>(pos, mesh->getTriangles(), mesh->getLodClusters(0), mat,
+                                                   mesh->getLodTriangles(level), mesh->getLodClusters(level),
+                                                   2.0f * mesh->getLod(level).error));
 }
 
 void RayTracer::addLight(const Light& l) {
@@ -498,21 +505,21 @@ void RayTracer::clearScene() {
 }
 
 void RayTracer::update() {
+    PROFILE_SCOPE("RayTracer::update");
+    
     trace();
-    updateFramebuffer();
 }
 
 void RayTracer::render() {
-    updateFramebuffer();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClearColor(0.2f,0.2f,0.2f,1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(displayShader);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, framebufferTexture);
-    glUniform1i(glGetUniformLocation(displayShader, "screenTexture"), 0);
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
-    glUseProgram(0);
-}
\ No newline at end of file
+    PROFILE_SCOPE("RayTracer::render");
+    
+    // Upload the image if it changed, and show it
+    if (!framebufferDirty) {
+        display.present(nullptr);
+        return;
+    }
+    int64_t start = Profiler::now();
+    display.present(reinterpret_cast<const float*>(frameBuffer.data()));
+    framebufferDirty = false;
+    stats.uploadTime = (Profiler::now() - start) / 1e6;
+}
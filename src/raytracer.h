@@ -3,8 +3,11 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <vector>
 #include <memory>
+#include <utility>
+#include "canvas_display.h"
 #include "mesh.h"
 
 // Forward declarations
@@ -46,6 +49,26 @@ struct Light {
         : position(pos), color(col), intensity(intens) {}
 };
 
+// What one trace() did. Counts are gathered per worker thread and summed
+// when the threads finish; times are in milliseconds.
+struct RayStats {
+    uint64_t primaryRays, shadowRays, reflectionRays;
+    uint64_t sphereTests, cubeTests, meshTests;     // Object intersections by type
+    uint64_t triangleTests;
+    uint64_t nodeVisits;        // Cluster bounding boxes tested, the meshes' acceleration structure
+    uint32_t maxPixelCost;      // Most intersection tests and node visits behind one pixel
+    double traceTime;           // Wall time of the whole trace
+    double threadTime;          // Summed over the worker threads
+    double slowestThreadTime;
+    double heatmapTime;         // Coloring pixels by cost, in heatmap view only
+    double uploadTime;          // Texture upload and present of the result
+    
+    uint64_t getRays() const { return primaryRays + shadowRays + reflectionRays; }
+    uint64_t getTests() const { return sphereTests + cubeTests + triangleTests + nodeVisits; }
+    double getRaysPerSecond() const { return traceTime > 0.0 ? getRays() / (traceTime / 1000.0) : 0.0; }
+    void add(const RayStats& other);
+};
+
 class Object {
 protected:
     glm::vec3 position;
@@ -54,6 +77,8 @@ public:
     Object(const glm::vec3& pos, const Material& mat) : position(pos), material(mat) {}
     virtual ~Object() {}
     virtual RayHit intersect(const Ray& ray) const = 0;
+    // Whether anything blocks the ray before maxDistance (shadow rays)
+    virtual bool occludes(const Ray& ray, float maxDistance) const;
     glm::vec3 getPosition() const { return position; }
     void setPosition(const glm::vec3& pos) { position = pos; }
     Material getMaterial() const { return material; }
@@ -84,10 +109,26 @@ public:
 
 class MeshObject : public Object {
     std::vector<Triangle> triangles;
+    // Clusters of the triangles (index ranges over them, times three);
+    // rays skip clusters whose box they miss. Empty tests every triangle.
+    std::vector<MeshCluster> clusters;
+    // Coarser level of detail used for shadow rays, and how far it may lie
+    // from the full surface; hits closer than that are self-shadowing
+    std::vector<Triangle> shadowTriangles;
+    std::vector<MeshCluster> shadowClusters;
+    float shadowBias;
 public:
-    MeshObject(const glm::vec3& pos, const std::vector<Triangle>& tris, const Material& mat)
-        : Object(pos, mat), triangles(tris) {}
+    // Take the triangle and cluster lists by value: Mesh builds them on
+    // request, and moving them in keeps a single copy
+    MeshObject(const glm::vec3& pos, std::vector<Triangle> tris, const Material& mat)
+        : Object(pos, mat), triangles(std::move(tris)), shadowBias(0.0f) {}
+    MeshObject(const glm::vec3& pos, std::vector<Triangle> tris, std::vector<MeshCluster> clus,
+               const Material& mat, std::vector<Triangle> shadowTris,
+               std::vector<MeshCluster> shadowClus, float bias)
+        : Object(pos, mat), triangles(std::move(tris)), clusters(std::move(clus)),
+          shadowTriangles(std::move(shadowTris)), shadowClusters(std::move(shadowClus)), shadowBias(bias) {}
     RayHit intersect(const Ray& ray) const override;
+    bool occludes(const Ray& ray, float maxDistance) const override;
     const std::vector<Triangle>& getTriangles() const { return triangles; }
 };
 
@@ -111,7 +152,7 @@ public:
 
 class RayTracer {
     int width, height;
-    GLuint framebufferTexture, framebufferFBO, displayShader, quadVAO, quadVBO;
+    CanvasDisplay display; // Texture, quad and shader the image is shown with
     std::vector<glm::vec3> frameBuffer;
     bool framebufferDirty;
     std::vector<std::shared_ptr<Object>> objects;
@@ -120,17 +161,16 @@ class RayTracer {
     int maxDepth;
     bool enableShadows, enableReflections;
     bool debugShadowView; // Added shadow debug view flag
-    void setupFramebuffer();
-    void setupQuad();
-    void setupShaders();
-    void updateFramebuffer();
+    int shadowLod; // Mesh level of detail shadow rays are traced against
+    bool heatmapView; // Color pixels by their cost instead of shading them
+    std::vector<uint32_t> pixelCost; // Tests and node visits per pixel of the last trace
+    RayStats stats;
     glm::vec3 traceRay(const Ray& ray, int depth);
     RayHit findClosestIntersection(const Ray& ray);
     bool isInShadow(const glm::vec3& point, const Light& light);
     void setPixel(int x, int y, const glm::vec3& color);
 public:
     RayTracer(int w, int h);
-    ~RayTracer();
     void resize(int w, int h);
     void addSphere(const glm::vec3& position, float radius, const Material& material);
     void addCube(const glm::vec3& position, const glm::vec3& size, const Material& material);
@@ -149,6 +189,11 @@ public:
     bool isReflectionsEnabled() const { return enableReflections; }
     void setDebugShadowView(bool enable) { debugShadowView = enable; } // Added getter/setter
     bool getDebugShadowView() const { return debugShadowView; }
+    void setShadowLod(int level) { shadowLod = level; } // Applies to meshes added afterwards
+    int getShadowLod() const { return shadowLod; }
+    void setHeatmapView(bool enable) { heatmapView = enable; }
+    bool getHeatmapView() const { return heatmapView; }
+    const RayStats& getStats() const { return stats; }
     void trace();
     void clear(const glm::vec3& color = glm::vec3(0.0f));
     void update();
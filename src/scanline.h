@@ -4,34 +4,16 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
-#include <list>
-
-// Updated Edge structure for scan-line algorithm using integer arithmetic
-struct Edge {
-    int ymax;       // Maximum y coordinate of the edge
-    int x;          // Current x coordinate (fixed-point, scaled by 1024)
-    int dx;         // Change in x for each unit y (fixed-point, scaled by 1024)
-    
-    Edge(int y, int x_start, int slope) : ymax(y), x(x_start), dx(slope) {}
-    
-    // Comparison operator for sorting edges by x coordinate
-    bool operator<(const Edge& other) const {
-        return x < other.x;
-    }
-};
+#include "canvas_display.h"
+#include "raster_core.h"
 
 class ScanLineRenderer {
 private:
     // Canvas dimensions
     int width, height;
     
-    // Framebuffer for scan-line rendering
-    GLuint framebufferTexture;
-    GLuint framebufferFBO;
-    
-    // Shader for displaying the framebuffer
-    GLuint displayShader;
-    GLuint quadVAO, quadVBO;
+    // Texture, quad and shader the canvas is shown with
+    CanvasDisplay display;
     
     // Polygon vertices
     std::vector<glm::vec2> polygonVertices;
@@ -39,35 +21,27 @@ private:
     // Fill color
     glm::vec3 fillColor;
     
-    // Edge table for scan-line algorithm (indexed by y)
-    std::vector<std::list<Edge>> edgeTable;
+    // Vertex precision and sampling position
+    FillMode fillMode;
     
-    // Bounds for the algorithm
-    int ymin, ymax;
+    // Scan converter, with its edge tables and per-thread scratch
+    ScanConverter scanConverter;
+    
+    // Batch redrawn by update() and the throughput of its last fill
+    PolygonBatch batch;
+    BatchFillStats batchStats;
 
     // New members
-    std::vector<float> frameBuffer;
+    RasterFramebuffer frameBuffer;
     bool framebufferDirty;
     
-    // Methods
-    void setupFramebuffer();
-    void setupQuad();
-    void setupShaders();
-    
-    // Scan-line fill algorithm methods
-    void findYMinMax();
-    void buildEdgeTable();
-    void scanLineFill();
-    
-    // Pixel setting
-    void setPixel(int x, int y, const glm::vec3& color);
-
-    // Buffer update
-    void updateFramebuffer();
+    // Input revision: bumped whenever anything update() draws from changes.
+    // update() skips all raster work while the drawn revision is current.
+    unsigned int revision;
+    unsigned int drawnRevision;
     
 public:
     ScanLineRenderer(int w, int h);
-    ~ScanLineRenderer();
     
     // Resize the renderer canvas
     void resize(int w, int h);
@@ -75,7 +49,15 @@ public:
     // Polygon management
     void addVertex(const glm::vec2& vertex);
     void clearPolygon();
-    void setFillColor(const glm::vec3& color) { fillColor = color; }
+    void setFillColor(const glm::vec3& color) {
+        if (color != fillColor) { fillColor = color; revision++; }
+    }
+    
+    // Vertex precision, used by both single-polygon and batch fills
+    void setFillMode(FillMode mode) {
+        if (mode != fillMode) { fillMode = mode; revision++; }
+    }
+    FillMode getFillMode() const { return fillMode; }
     
     // Get polygon vertices
     const std::vector<glm::vec2>& getPolygonVertices() const { return polygonVertices; }
@@ -83,10 +65,23 @@ public:
     // Fill the current polygon
     void fillPolygon();
     
+    // Scan-convert a whole batch of polygons into the framebuffer, splitting
+    // the screen into tiles of rows that are filled in parallel
+    void fillPolygons(const PolygonBatch& polygons);
+    const BatchFillStats& getBatchStats() const { return batchStats; }
+    
+    // Batch redrawn underneath the single polygon on every update()
+    void setBatch(const PolygonBatch& polygons) { batch = polygons; revision++; }
+    void clearBatch() {
+        if (!batch.empty()) { batch.clear(); revision++; }
+    }
+    const PolygonBatch& getBatch() const { return batch; }
+    
     // Clear the framebuffer
     void clear(const glm::vec3& color = glm::vec3(0.0f));
     
-    // Update and render
+    // Update and render. update() redraws only when the input has changed
+    // since the last redraw, and render() uploads only after a redraw.
     void update();
     void render();
 };
@@ -0,0 +1,130 @@
+#include "shader_manager.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+// Header of a cache file, followed by the binary itself
+const uint32_t SHADER_BINARY_MAGIC = 0x31425053;  // "SPB1"
+
+struct ShaderBinaryHeader {
+    uint32_t magic;
+    uint32_t format;
+};
+
+// FNV-1a, 64 bit: stable across runs and builds, unlike std::hash
+static uint64_t hashString(uint64_t hash, const std::string& text) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+ShaderManager::ShaderManager() : compiledCount(0), binaryLoadCount(0) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats > 0) {
+        driverId = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+    }
+}
+
+std::string ShaderManager::cachePath(const std::vector<std::string>& sources) const {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashString(hash, driverId);
+    for (const std::string& source : sources) {
+        hash = hashString(hash, std::string(1, '\0') + source);
+    }
+    
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return std::string(SHADER_CACHE_DIRECTORY) + "/" + name;
+}
+
+ShaderProgram* ShaderManager::loadBinary(const std::string& path) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return nullptr;
+    }
+    
+    ShaderBinaryHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != SHADER_BINARY_MAGIC) {
+        return nullptr;
+    }
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) {
+        return nullptr;
+    }
+    return ShaderProgram::fromBinary(header.format, binary);
+}
+
+void ShaderManager::saveBinary(const std::string& path, const ShaderProgram& program) const {
+    GLenum format = 0;
+    std::vector<char> binary;
+    if (!program.getBinary(format, binary)) {
+        return;
+    }
+    
+    // The cache only speeds up startup, so failing to write it is not an
+    // error worth more than a note
+    std::error_code error;
+    std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Could not write shader cache file: " << path << std::endl;
+        return;
+    }
+    ShaderBinaryHeader header = { SHADER_BINARY_MAGIC, format };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), binary.size());
+}
+
+ShaderProgram* ShaderManager::getProgram(const std::string& vertexPath, const std::string& fragmentPath) {
+    return findOrBuild(vertexPath + "|" + fragmentPath, { vertexPath, fragmentPath });
+}
+
+ShaderProgram* ShaderManager::getComputeProgram(const std::string& computePath) {
+    return findOrBuild(computePath, { computePath });
+}
+
+ShaderProgram* ShaderManager::findOrBuild(const std::string& key, const std::vector<std::string>& paths) {
+    auto it = programs.find(key);
+    if (it != programs.end()) {
+        return it->second.get();
+    }
+    
+    std::vector<std::string> sources;
+    for (const std::string& path : paths) {
+        sources.push_back(readShaderFile(path));
+    }
+    
+    // A binary from an earlier run, if the driver supports them
+    ShaderProgram* program = nullptr;
+    std::string path;
+    if (!driverId.empty()) {
+        path = cachePath(sources);
+        program = loadBinary(path);
+        if (program) {
+            binaryLoadCount++;
+        }
+    }
+    
+    // Otherwise compile, and keep the binary for the next run
+    if (!program) {
+        program = sources.size() == 1 ? new ShaderProgram(sources[0]) : new ShaderProgram(sources[0], sources[1]);
+        compiledCount++;
+        if (program->isLinked() && !path.empty()) {
+            saveBinary(path, *program);
+        }
+    }
+    
+    programs[key].reset(program);
+    return program;
+}
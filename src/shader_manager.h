@@ -0,0 +1,65 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <GL/glew.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shader_program.h"
+
+// Program binaries are kept here, relative to the working directory the
+// app runs from (the repository root, like the shader paths)
+const char* const SHADER_CACHE_DIRECTORY = "build/shader_cache";
+
+// Full-screen quad program shared by the views that render on the CPU
+const char* const DISPLAY_VERTEX_SHADER_PATH = "shaders/display.vert";
+const char* const DISPLAY_FRAGMENT_SHADER_PATH = "shaders/display.frag";
+
+// Owns every shader program of the app. A program is compiled once per
+// process for each pair of shader files and shared by everything asking
+// for it, so loading another model does not recompile the mesh shaders.
+// Compute programs are handled the same way.
+//
+// Linked programs are also saved with glGetProgramBinary and loaded with
+// glProgramBinary on later runs, skipping compilation entirely. Cache files
+// are named after a hash of both sources and the GL vendor, renderer and
+// version strings, so editing a shader or updating the driver misses the
+// cache instead of loading a stale binary; a binary the driver rejects
+// anyway is recompiled and overwritten.
+class ShaderManager {
+private:
+    std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> programs;
+    
+    // Identifies the driver the binaries were produced by, or empty if it
+    // supports no binary formats and nothing is cached on disk
+    std::string driverId;
+    
+    // What happened to the programs requested so far
+    int compiledCount;
+    int binaryLoadCount;
+    
+    // Program from one compute shader file or a vertex and a fragment file
+    ShaderProgram* findOrBuild(const std::string& key, const std::vector<std::string>& paths);
+    std::string cachePath(const std::vector<std::string>& sources) const;
+    ShaderProgram* loadBinary(const std::string& path) const;
+    void saveBinary(const std::string& path, const ShaderProgram& program) const;
+
+public:
+    ShaderManager();
+    
+    // The program built from the two shader files; compiled, or loaded from
+    // the binary cache, on the first request only. Never null: a program
+    // that failed to compile is kept too (unlinked), so the error is
+    // reported once.
+    ShaderProgram* getProgram(const std::string& vertexPath, const std::string& fragmentPath);
+    
+    // Same for a compute program
+    ShaderProgram* getComputeProgram(const std::string& computePath);
+    
+    int getProgramCount() const { return static_cast<int>(programs.size()); }
+    int getCompiledCount() const { return compiledCount; }
+    int getBinaryLoadCount() const { return binaryLoadCount; }
+};
+
+#endif // SHADER_MANAGER_H
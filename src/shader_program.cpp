@@ -0,0 +1,203 @@
+#include "shader_program.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+std::string readShaderFile(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        std::cerr << "Could not open file: " << filePath << std::endl;
+        return "";
+    }
+    
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+// Compile one stage, reporting errors under the given stage name
+static GLuint compileShader(GLenum type, const std::string& source, const char* stageName) {
+    const char* code = source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+    
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+    return shader;
+}
+
+ShaderProgram::ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource) {
+    GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource, "VERTEX");
+    GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource, "FRAGMENT");
+    link({ vertex, fragment });
+}
+
+ShaderProgram::ShaderProgram(const std::string& computeSource) {
+    link({ compileShader(GL_COMPUTE_SHADER, computeSource, "COMPUTE") });
+}
+
+void ShaderProgram::link(std::initializer_list<GLuint> shaders) {
+    program = glCreateProgram();
+    for (GLuint shader : shaders) {
+        glAttachShader(program, shader);
+    }
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    
+    // Delete the shaders after linking
+    for (GLuint shader : shaders) {
+        glDeleteShader(shader);
+    }
+    
+    linked = success != 0;
+    if (linked) {
+        finishLink();
+    }
+}
+
+ShaderProgram::ShaderProgram(GLuint linkedProgram) : program(linkedProgram), linked(true) {
+    finishLink();
+}
+
+ShaderProgram* ShaderProgram::fromBinary(GLenum format, const std::vector<char>& binary) {
+    GLuint id = glCreateProgram();
+    glProgramBinary(id, format, binary.data(), static_cast<GLsizei>(binary.size()));
+    
+    int success;
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(id);
+        return nullptr;
+    }
+    return new ShaderProgram(id);
+}
+
+bool ShaderProgram::getBinary(GLenum& format, std::vector<char>& binary) const {
+    GLint length = 0;
+    if (linked) {
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    }
+    if (length <= 0) {
+        return false;
+    }
+    
+    binary.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    binary.resize(written);
+    return written > 0;
+}
+
+// Loading a binary resets uniform block bindings, so both creation paths
+// bind the block here, after linking
+void ShaderProgram::finishLink() {
+    cacheUniforms();
+    
+    GLuint frameBlock = glGetUniformBlockIndex(program, "FrameConstants");
+    if (frameBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, frameBlock, FRAME_UNIFORM_BINDING);
+    }
+}
+
+ShaderProgram::~ShaderProgram() {
+    glDeleteProgram(program);
+}
+
+void ShaderProgram::cacheUniforms() {
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    
+    std::string name(maxLength, '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(i), maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName(name.data(), length);
+        
+        // Members of uniform blocks have no location
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        if (location < 0) continue;
+        
+        // Arrays are reported as "name[0]"; make them reachable as "name" too
+        uniformLocations[uniformName] = location;
+        size_t bracket = uniformName.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size()) {
+            uniformLocations[uniformName.substr(0, bracket)] = location;
+        }
+    }
+}
+
+GLint ShaderProgram::getUniformLocation(const std::string& name) const {
+    auto it = uniformLocations.find(name);
+    return it != uniformLocations.end() ? it->second : -1;
+}
+
+void ShaderProgram::setInt(const std::string& name, int value) const {
+    GLint location = getUniformLocation(name);
+    if (location >= 0) glUniform1i(location, value);
+}
+
+void ShaderProgram::setFloat(const std::string& name, float value) const {
+    GLint location = getUniformLocation(name);
+    if (location >= 0) glUniform1f(location, value);
+}
+
+void ShaderProgram::setVec3(const std::string& name, const glm::vec3& value) const {
+    GLint location = getUniformLocation(name);
+    if (location >= 0) glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::setFloatArray(const std::string& name, const float* values, int count) const {
+    GLint location = getUniformLocation(name);
+    if (location >= 0) glUniform1fv(location, count, values);
+}
+
+void ShaderProgram::setVec4Array(const std::string& name, const glm::vec4* values, int count) const {
+    GLint location = getUniformLocation(name);
+    if (location >= 0) glUniform4fv(location, count, glm::value_ptr(values[0]));
+}
+
+void ShaderProgram::setMat4(const std::string& name, const glm::mat4& value) const {
+    GLint location = getUniformLocation(name);
+    if (location >= 0) glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+FrameUniforms::FrameUniforms() : constants() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, buffer);
+}
+
+FrameUniforms::~FrameUniforms() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void FrameUniforms::update(const FrameConstants& frame) {
+    constants = frame;
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), &constants);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    
+    // Nothing else uses the binding point, but rebinding is cheap and keeps
+    // the block valid if that changes
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, buffer);
+}
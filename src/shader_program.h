@@ -0,0 +1,106 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Binding point of the FrameConstants uniform block
+const GLuint FRAME_UNIFORM_BINDING = 0;
+
+// Read a shader source file, or return an empty string (and report it) when
+// the file cannot be opened
+std::string readShaderFile(const std::string& filePath);
+
+// A linked vertex + fragment program, or a compute program. The locations
+// of all active uniforms are looked up once after linking, so setting a
+// uniform by name is a hash lookup instead of a glGetUniformLocation call
+// into the driver. Uniforms the linker removed are silently skipped, like
+// location -1 would be.
+//
+// Programs declaring the FrameConstants block are bound to
+// FRAME_UNIFORM_BINDING and read the camera and light from FrameUniforms.
+// Programs are normally obtained from ShaderManager, which shares them and
+// caches their binaries.
+class ShaderProgram {
+private:
+    GLuint program;
+    bool linked;
+    std::unordered_map<std::string, GLint> uniformLocations;
+    
+    explicit ShaderProgram(GLuint linkedProgram);
+    void link(std::initializer_list<GLuint> shaders);
+    void finishLink();
+    void cacheUniforms();
+
+public:
+    ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource);
+    explicit ShaderProgram(const std::string& computeSource);
+    ~ShaderProgram();
+    
+    // Program from a binary returned by getBinary(), or nullptr if the
+    // driver rejects it (e.g. it was saved by another driver version)
+    static ShaderProgram* fromBinary(GLenum format, const std::vector<char>& binary);
+    
+    // Linked program binary in the driver's format; false if unavailable
+    bool getBinary(GLenum& format, std::vector<char>& binary) const;
+    
+    bool isLinked() const { return linked; }
+    
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+    
+    void use() const { glUseProgram(program); }
+    GLuint getId() const { return program; }
+    
+    // Cached location, or -1 if the program has no such active uniform
+    GLint getUniformLocation(const std::string& name) const;
+    
+    // Set a uniform of this program; the program must be in use
+    void setInt(const std::string& name, int value) const;
+    void setFloat(const std::string& name, float value) const;
+    void setVec3(const std::string& name, const glm::vec3& value) const;
+    void setFloatArray(const std::string& name, const float* values, int count) const;
+    void setVec4Array(const std::string& name, const glm::vec4* values, int count) const;
+    void setMat4(const std::string& name, const glm::mat4& value) const;
+};
+
+// Camera and light constants shared by all programs, in the std140 layout
+// of the FrameConstants block (vec3s are padded to vec4)
+struct FrameConstants {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 viewPos;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+};
+
+// The uniform buffer behind the FrameConstants block. It is filled once per
+// frame and stays bound to FRAME_UNIFORM_BINDING, so drawing code only sets
+// its own per-object uniforms. The CPU copy serves the renderers that need
+// the same camera without going through GL.
+class FrameUniforms {
+private:
+    GLuint buffer;
+    FrameConstants constants;
+
+public:
+    FrameUniforms();
+    ~FrameUniforms();
+    
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+    
+    // Upload the constants for the coming frame
+    void update(const FrameConstants& frame);
+    
+    const FrameConstants& getConstants() const { return constants; }
+    glm::vec3 getViewPos() const { return glm::vec3(constants.viewPos); }
+    glm::vec3 getLightPos() const { return glm::vec3(constants.lightPos); }
+    glm::vec3 getLightColor() const { return glm::vec3(constants.lightColor); }
+};
+
+#endif // SHADER_PROGRAM_H
@@ -1,8 +1,10 @@
 #include "slicer.h"
-#include <glm/gtc/type_ptr.hpp>
+#include "profiler.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cmath>
+
+// External variables from main.cpp
+extern ShaderManager* shader_manager;
 
 // Shader paths
 const char* sliceVertexShaderPath = "shaders/slice.vert";
@@ -18,19 +20,6 @@ const glm::vec3 REGION_COLORS[] = {
     glm::vec3(0.4f, 0.9f, 0.9f)  // Cyan region
 };
 
-// Utility function to read shader source (same as in mesh.cpp)
-std::string readSliceShaderFile(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        std::cerr << "Could not open file: " << filePath << std::endl;
-        return "";
-    }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-
 MeshSlicer::MeshSlicer(Mesh* m) : mesh(m), showSlice(true), activeSlicePlane(0) {
     // Add a default horizontal plane
     planes.push_back(Plane(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f));
@@ -47,7 +36,6 @@ MeshSlicer::~MeshSlicer() {
     // Cleanup OpenGL resources
     glDeleteVertexArrays(1, &sliceVAO);
     glDeleteBuffers(1, &sliceVBO);
-    glDeleteProgram(sliceShaderProgram);
 }
 
 void MeshSlicer::setupSliceVisualization() {
@@ -56,54 +44,7 @@ void MeshSlicer::setupSliceVisualization() {
     glGenBuffers(1, &sliceVBO);
     
     // Create shaders for slice visualization
-    std::string vertexShaderSource = readSliceShaderFile(sliceVertexShaderPath);
-    std::string fragmentShaderSource = readSliceShaderFile(sliceFragmentShaderPath);
-    
-    const char* vShaderCode = vertexShaderSource.c_str();
-    const char* fShaderCode = fragmentShaderSource.c_str();
-    
-    // Compile shaders
-    GLuint vertex, fragment;
-    int success;
-    char infoLog[512];
-    
-    // Vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-    
-    // Fragment shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-    
-    // Shader program
-    sliceShaderProgram = glCreateProgram();
-    glAttachShader(sliceShaderProgram, vertex);
-    glAttachShader(sliceShaderProgram, fragment);
-    glLinkProgram(sliceShaderProgram);
-    
-    glGetProgramiv(sliceShaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(sliceShaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-    }
-    
-    // Delete the shaders after linking
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    sliceShaderProgram = shader_manager->getProgram(sliceVertexShaderPath, sliceFragmentShaderPath);
 }
 
 void MeshSlicer::addPlane(const Plane& plane) {
@@ -140,6 +81,8 @@ void MeshSlicer::clearPlanes() {
 }
 
 void MeshSlicer::computeSlice() {
+    PROFILE_SCOPE("MeshSlicer::computeSlice");
+    
     // Clear existing slice
     sliceVertices.clear();
     
@@ -147,6 +90,7 @@ void MeshSlicer::computeSlice() {
     for (const auto& plane : planes) {
         sliceWithPlane(plane);
     }
+    PROFILE_COUNTER("slice segments", static_cast<int64_t>(sliceVertices.size() / 2));
     
     // Upload slice vertices to GPU
     glBindVertexArray(sliceVAO);
@@ -162,54 +106,71 @@ void MeshSlicer::computeSlice() {
 }
 
 void MeshSlicer::sliceWithPlane(const Plane& plane) {
-    // Get triangles from mesh
-    const std::vector<Triangle>& triangles = mesh->getTriangles();
+    // Slice the indexed triangles of LOD 0 in the ranges of its clusters,
+    // read in place: cluster index ranges are into the whole index buffer
+    const std::vector<MeshVertex>& vertices = mesh->getVertices();
+    const std::vector<unsigned int>& indices = mesh->getIndices();
+    const MeshLod& lod = mesh->getLod(0);
+    const std::vector<MeshCluster>& clusters = mesh->getClusters();
     
-    // Slice each triangle with the plane
-    for (const auto& triangle : triangles) {
-        // Compute signed distances from vertices to plane
-        float d0 = plane.signedDistance(triangle.v0.position);
-        float d1 = plane.signedDistance(triangle.v1.position);
-        float d2 = plane.signedDistance(triangle.v2.position);
+    for (unsigned int c = lod.clusterOffset; c < lod.clusterOffset + lod.clusterCount; c++) {
+        const MeshCluster& cluster = clusters[c];
         
-        // Check if triangle intersects with plane
-        if ((d0 * d1 <= 0.0f) || (d0 * d2 <= 0.0f) || (d1 * d2 <= 0.0f)) {
-            // Find intersections
-            std::vector<glm::vec3> intersections;
+        // Skip clusters whose box lies entirely on one side of the plane
+        glm::vec3 center = (cluster.boundsMin + cluster.boundsMax) * 0.5f;
+        glm::vec3 extent = (cluster.boundsMax - cluster.boundsMin) * 0.5f;
+        if (std::abs(plane.signedDistance(center)) > glm::dot(glm::abs(plane.normal), extent)) continue;
+        
+        // Slice each triangle with the plane
+        for (unsigned int i = cluster.indexOffset / 3; i < (cluster.indexOffset + cluster.indexCount) / 3; i++) {
+            const glm::vec3& p0 = vertices[indices[i * 3]].position;
+            const glm::vec3& p1 = vertices[indices[i * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[i * 3 + 2]].position;
             
-            if (d0 * d1 <= 0.0f && d0 != 0.0f && d1 != 0.0f) {
-                glm::vec3 intersection;
-                findIntersection(triangle.v0.position, triangle.v1.position, d0, d1, intersection);
-                intersections.push_back(intersection);
-            }
+            // Compute signed distances from vertices to plane
+            float d0 = plane.signedDistance(p0);
+            float d1 = plane.signedDistance(p1);
+            float d2 = plane.signedDistance(p2);
             
-            if (d0 * d2 <= 0.0f && d0 != 0.0f && d2 != 0.0f) {
-                glm::vec3 intersection;
-                findIntersection(triangle.v0.position, triangle.v2.position, d0, d2, intersection);
-                intersections.push_back(intersection);
-            }
+            // Check if triangle intersects with plane
+            if ((d0 * d1 <= 0.0f) || (d0 * d2 <= 0.0f) || (d1 * d2 <= 0.0f)) {
+                // Find intersections
+                std::vector<glm::vec3> intersections;
             
-            if (d1 * d2 <= 0.0f && d1 != 0.0f && d2 != 0.0f) {
-                glm::vec3 intersection;
-                findIntersection(triangle.v1.position, triangle.v2.position, d1, d2, intersection);
-                intersections.push_back(intersection);
-            }
+                if (d0 * d1 <= 0.0f && d0 != 0.0f && d1 != 0.0f) {
+                    glm::vec3 intersection;
+                    findIntersection(p0, p1, d0, d1, intersection);
+                    intersections.push_back(intersection);
+                }
             
-            // Handle vertices exactly on the plane
-            if (d0 == 0.0f) {
-                intersections.push_back(triangle.v0.position);
-            }
-            if (d1 == 0.0f) {
-                intersections.push_back(triangle.v1.position);
-            }
-            if (d2 == 0.0f) {
-                intersections.push_back(triangle.v2.position);
-            }
+                if (d0 * d2 <= 0.0f && d0 != 0.0f && d2 != 0.0f) {
+                    glm::vec3 intersection;
+                    findIntersection(p0, p2, d0, d2, intersection);
+                    intersections.push_back(intersection);
+                }
+            
+                if (d1 * d2 <= 0.0f && d1 != 0.0f && d2 != 0.0f) {
+                    glm::vec3 intersection;
+                    findIntersection(p1, p2, d1, d2, intersection);
+                    intersections.push_back(intersection);
+                }
             
-            // If we have 2 intersections, add a line segment to the slice
-            if (intersections.size() >= 2) {
-                sliceVertices.push_back(intersections[0]);
-                sliceVertices.push_back(intersections[1]);
+                // Handle vertices exactly on the plane
+                if (d0 == 0.0f) {
+                    intersections.push_back(p0);
+                }
+                if (d1 == 0.0f) {
+                    intersections.push_back(p1);
+                }
+                if (d2 == 0.0f) {
+                    intersections.push_back(p2);
+                }
+            
+                // If we have 2 intersections, add a line segment to the slice
+                if (intersections.size() >= 2) {
+                    sliceVertices.push_back(intersections[0]);
+                    sliceVertices.push_back(intersections[1]);
+                }
             }
         }
     }
@@ -270,34 +231,22 @@ void MeshSlicer::update() {
 }
 
 void MeshSlicer::render() {
+    PROFILE_SCOPE("MeshSlicer::render");
+    GpuTimerScope gpuScope(renderTimer);
+    
     // First render the mesh
     mesh->render();
     
     // Then render the slice if enabled
     if (showSlice && !sliceVertices.empty()) {
-        glUseProgram(sliceShaderProgram);
-        
-        // Set uniforms (view, projection, etc.)
-        glm::mat4 model = mesh->getModelMatrix();
-        glm::mat4 view = glm::mat4(1.0f);
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 
-                                               (float)1280/(float)720, 0.1f, 100.0f);
-        
-        // Setup view matrix (same as in mesh rendering)
-        view = glm::translate(view, glm::vec3(0.0f, 0.0f, -5.0f));
-        
-        // Set matrices
-        glUniformMatrix4fv(glGetUniformLocation(sliceShaderProgram, "model"), 1, GL_FALSE, 
-                          glm::value_ptr(model));
-        glUniformMatrix4fv(glGetUniformLocation(sliceShaderProgram, "view"), 1, GL_FALSE, 
-                          glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(sliceShaderProgram, "projection"), 1, GL_FALSE, 
-                          glm::value_ptr(projection));
+        // View and projection come from the per-frame uniform buffer, so
+        // the slice lines use the same camera as the mesh under them
+        sliceShaderProgram->use();
+        sliceShaderProgram->setMat4("model", mesh->getModelMatrix());
         
         // Set slice color
         glm::vec3 sliceColor(1.0f, 0.0f, 0.0f); // Red slice
-        glUniform3fv(glGetUniformLocation(sliceShaderProgram, "sliceColor"), 1, 
-                    glm::value_ptr(sliceColor));
+        sliceShaderProgram->setVec3("sliceColor", sliceColor);
         
         // Draw slice lines
         glBindVertexArray(sliceVAO);
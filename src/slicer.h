@@ -29,7 +29,8 @@ private:
     // Slice visualization
     GLuint sliceVAO, sliceVBO;
     std::vector<glm::vec3> sliceVertices;
-    GLuint sliceShaderProgram;
+    ShaderProgram* sliceShaderProgram;
+    GpuTimer renderTimer{"MeshSlicer::render"};     // Including the mesh
     
     // UI state
     bool showSlice;
@@ -0,0 +1,472 @@
+#include "soft_pipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+// Triangles are binned into squares of BIN_SIZE pixels, and walked inside a
+// bin in blocks of BLOCK_SIZE pixels, which is also the granularity of the
+// hierarchical z-buffer
+const int BIN_SIZE = 64;
+const int BLOCK_SIZE = 8;
+
+// Triangles are only clipped against x and y once they reach this many
+// viewport half-widths from the center; anything inside the guard band is
+// clipped to the screen by the rasterizer's bounding box instead
+const float GUARD_BAND = 8.0f;
+
+// Clip-space outcodes: one bit per clipping plane
+enum {
+    CLIP_LEFT = 1, CLIP_RIGHT = 2, CLIP_BOTTOM = 4, CLIP_TOP = 8, CLIP_NEAR = 16, CLIP_FAR = 32
+};
+
+// Signed distance of a clip-space position to each plane; >= 0 is inside
+static inline float planeDistance(const glm::vec4& p, int plane) {
+    switch (plane) {
+        case CLIP_LEFT:   return p.x + GUARD_BAND * p.w;
+        case CLIP_RIGHT:  return GUARD_BAND * p.w - p.x;
+        case CLIP_BOTTOM: return p.y + GUARD_BAND * p.w;
+        case CLIP_TOP:    return GUARD_BAND * p.w - p.y;
+        case CLIP_NEAR:   return p.z + p.w;
+        default:          return p.w - p.z;
+    }
+}
+
+static inline int outcode(const glm::vec4& p) {
+    int code = 0;
+    for (int plane = CLIP_LEFT; plane <= CLIP_FAR; plane <<= 1) {
+        if (planeDistance(p, plane) < 0.0f) code |= plane;
+    }
+    return code;
+}
+
+static inline long long floorDiv(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+// Same lighting as shaders/basic.frag; pow(x, 32) is five squarings
+static inline glm::vec3 shade(const glm::vec3& fragPos, const glm::vec3& normal, const glm::vec3& color,
+                              const SoftLighting& lighting) {
+    // Ambient lighting
+    glm::vec3 ambient = 0.2f * lighting.lightColor;
+    
+    // Diffuse lighting
+    glm::vec3 norm = glm::normalize(normal);
+    glm::vec3 lightDir = glm::normalize(lighting.lightPos - fragPos);
+    float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+    glm::vec3 diffuse = diff * lighting.lightColor;
+    
+    // Specular lighting
+    glm::vec3 viewDir = glm::normalize(lighting.viewPos - fragPos);
+    glm::vec3 reflectDir = glm::reflect(-lightDir, norm);
+    float spec = std::max(glm::dot(viewDir, reflectDir), 0.0f);
+    for (int i = 0; i < 5; i++) spec *= spec;
+    glm::vec3 specular = 0.5f * spec * lighting.lightColor;
+    
+    // Combined lighting with vertex color, clamped like a fixed-point target
+    return glm::min((ambient + diffuse + specular) * color, glm::vec3(1.0f));
+}
+
+// Run fn(thread) on numThreads threads, or inline when there is only one
+template <typename F>
+static void runThreads(int numThreads, F fn) {
+    if (numThreads == 1) {
+        fn(0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back(fn, t);
+    }
+    for (auto& t : threads) t.join();
+}
+
+SoftwarePipeline::SoftwarePipeline()
+    : shadingMode(SHADE_PHONG), width(0), height(0), blocksX(0), blocksY(0), binsX(0), binsY(0) {
+}
+
+void SoftwarePipeline::resizeTargets(int w, int h) {
+    width = w;
+    height = h;
+    blocksX = (w + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blocksY = (h + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    binsX = (w + BIN_SIZE - 1) / BIN_SIZE;
+    binsY = (h + BIN_SIZE - 1) / BIN_SIZE;
+    depthBuffer.resize(static_cast<size_t>(w) * h);
+    blockMaxDepth.resize(static_cast<size_t>(blocksX) * blocksY);
+}
+
+void SoftwarePipeline::clear(RasterFramebuffer& target, const glm::vec3& color) {
+    if (target.getWidth() != width || target.getHeight() != height) {
+        resizeTargets(target.getWidth(), target.getHeight());
+    }
+    target.clear(color);
+    std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+    std::fill(blockMaxDepth.begin(), blockMaxDepth.end(), 1.0f);
+}
+
+void SoftwarePipeline::transformVertices(const SoftVertexInput& input, int begin, int end,
+                                         const glm::mat4& model, const glm::mat3& normalMatrix,
+                                         const glm::mat4& viewProjection, const SoftLighting& lighting) {
+    const unsigned char* base = static_cast<const unsigned char*>(input.data);
+    
+    for (int i = begin; i < end; i++) {
+        const unsigned char* v = base + static_cast<size_t>(i) * input.stride;
+        glm::vec3 position = *reinterpret_cast<const glm::vec3*>(v + input.positionOffset);
+        glm::vec3 normal = *reinterpret_cast<const glm::vec3*>(v + input.normalOffset);
+        glm::vec3 color = *reinterpret_cast<const glm::vec3*>(v + input.colorOffset);
+        
+        // Same outputs as shaders/basic.vert
+        glm::vec4 worldPos = model * glm::vec4(position, 1.0f);
+        clipPositions[i] = viewProjection * worldPos;
+        
+        ShadeVertex& out = shadeVertices[i];
+        out.worldPos = glm::vec3(worldPos);
+        out.normal = normalMatrix * normal;
+        out.color = shadingMode == SHADE_GOURAUD ? shade(out.worldPos, out.normal, color, lighting) : color;
+    }
+}
+
+void SoftwarePipeline::setupTriangles(const unsigned int* indices, int begin, int end, BinnerScratch& binner) {
+    for (int t = begin; t < end; t++) {
+        int vertex[3] = {
+            static_cast<int>(indices[t * 3]),
+            static_cast<int>(indices[t * 3 + 1]),
+            static_cast<int>(indices[t * 3 + 2])
+        };
+        glm::vec4 clip[3] = { clipPositions[vertex[0]], clipPositions[vertex[1]], clipPositions[vertex[2]] };
+        
+        // Trivially reject triangles entirely outside one plane, and only
+        // run the clipper for those crossing a plane
+        int c0 = outcode(clip[0]), c1 = outcode(clip[1]), c2 = outcode(clip[2]);
+        if (c0 & c1 & c2) continue;
+        
+        if ((c0 | c1 | c2) == 0) {
+            emitTriangle(clip, vertex, binner);
+        } else {
+            clipTriangle(vertex, c0 | c1 | c2, binner);
+        }
+    }
+}
+
+void SoftwarePipeline::clipTriangle(const int* vertex, int outcodeUnion, BinnerScratch& binner) {
+    // Sutherland-Hodgman against each plane the triangle crosses. A
+    // triangle clipped by all six planes has at most nine vertices.
+    struct ClipVertex {
+        glm::vec4 clip;
+        int index;
+    };
+    ClipVertex polygon[2][9];
+    int count = 3;
+    int current = 0;
+    for (int i = 0; i < 3; i++) {
+        polygon[0][i] = { clipPositions[vertex[i]], vertex[i] };
+    }
+    
+    // Attributes of a vertex index, wherever it lives
+    auto attributes = [&](int index) -> ShadeVertex {
+        return index >= 0 ? shadeVertices[index] : binner.clipVertices[-index - 1];
+    };
+    
+    for (int plane = CLIP_LEFT; plane <= CLIP_FAR && count >= 3; plane <<= 1) {
+        if (!(outcodeUnion & plane)) continue;
+        
+        const ClipVertex* in = polygon[current];
+        ClipVertex* out = polygon[current ^ 1];
+        int outCount = 0;
+        
+        for (int i = 0; i < count; i++) {
+            const ClipVertex& a = in[i];
+            const ClipVertex& b = in[(i + 1) % count];
+            float da = planeDistance(a.clip, plane);
+            float db = planeDistance(b.clip, plane);
+            
+            if (da >= 0.0f) {
+                out[outCount++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                // New vertex where the edge crosses the plane
+                float t = da / (da - db);
+                ShadeVertex va = attributes(a.index);
+                ShadeVertex vb = attributes(b.index);
+                ShadeVertex v;
+                v.worldPos = va.worldPos + (vb.worldPos - va.worldPos) * t;
+                v.normal = va.normal + (vb.normal - va.normal) * t;
+                v.color = va.color + (vb.color - va.color) * t;
+                binner.clipVertices.push_back(v);
+                
+                out[outCount++] = { a.clip + (b.clip - a.clip) * t,
+                                    -static_cast<int>(binner.clipVertices.size()) };
+            }
+        }
+        
+        count = outCount;
+        current ^= 1;
+    }
+    
+    // Fan-triangulate what is left
+    for (int i = 1; i + 1 < count; i++) {
+        glm::vec4 clip[3] = { polygon[current][0].clip, polygon[current][i].clip, polygon[current][i + 1].clip };
+        int index[3] = { polygon[current][0].index, polygon[current][i].index, polygon[current][i + 1].index };
+        emitTriangle(clip, index, binner);
+    }
+}
+
+void SoftwarePipeline::emitTriangle(const glm::vec4* clip, const int* vertex, BinnerScratch& binner) {
+    SetupTriangle tri;
+    
+    // Perspective divide and viewport transform. Screen y grows downward to
+    // match RasterFramebuffer rows; positions snap to 1/256 pixel.
+    for (int i = 0; i < 3; i++) {
+        if (clip[i].w <= 0.0f) return;
+        float invW = 1.0f / clip[i].w;
+        float sx = (clip[i].x * invW * 0.5f + 0.5f) * width;
+        float sy = (0.5f - clip[i].y * invW * 0.5f) * height;
+        tri.x[i] = static_cast<int>(std::lround(sx * SUBPIXEL_SCALE));
+        tri.y[i] = static_cast<int>(std::lround(sy * SUBPIXEL_SCALE));
+        tri.z[i] = clip[i].z * invW * 0.5f + 0.5f;
+        tri.invW[i] = invW;
+        tri.vertex[i] = vertex[i];
+    }
+    
+    // Counter-clockwise (front) faces come out negative because screen y
+    // is flipped. Cull back faces and degenerate triangles like
+    // GL_CULL_FACE does, then swap two vertices so the area is positive.
+    long long area = static_cast<long long>(tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) -
+                     static_cast<long long>(tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+    if (area >= 0) return;
+    std::swap(tri.x[1], tri.x[2]);
+    std::swap(tri.y[1], tri.y[2]);
+    std::swap(tri.z[1], tri.z[2]);
+    std::swap(tri.invW[1], tri.invW[2]);
+    std::swap(tri.vertex[1], tri.vertex[2]);
+    tri.area = -area;
+    
+    // Pixels whose centers lie inside the bounding box, clipped to the target
+    const int half = SUBPIXEL_SCALE / 2;
+    int minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+    int maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+    int minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+    int maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+    tri.minX = std::max(0, static_cast<int>(-floorDiv(half - minX, SUBPIXEL_SCALE)));
+    tri.minY = std::max(0, static_cast<int>(-floorDiv(half - minY, SUBPIXEL_SCALE)));
+    tri.maxX = std::min(width - 1, static_cast<int>(floorDiv(maxX - half, SUBPIXEL_SCALE)));
+    tri.maxY = std::min(height - 1, static_cast<int>(floorDiv(maxY - half, SUBPIXEL_SCALE)));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY) return; // Covers no pixel center
+    
+    tri.zmin = std::min(tri.z[0], std::min(tri.z[1], tri.z[2]));
+    
+    // Add the triangle to every bin its bounding box overlaps
+    int index = static_cast<int>(binner.triangles.size());
+    binner.triangles.push_back(tri);
+    for (int by = tri.minY / BIN_SIZE; by <= tri.maxY / BIN_SIZE; by++) {
+        for (int bx = tri.minX / BIN_SIZE; bx <= tri.maxX / BIN_SIZE; bx++) {
+            binner.bins[by * binsX + bx].push_back(index);
+        }
+    }
+}
+
+long long SoftwarePipeline::rasterizeBin(RasterFramebuffer& target, int bin, const SoftLighting& lighting,
+                                         long long& blocksRejected) {
+    const int binX0 = (bin % binsX) * BIN_SIZE;
+    const int binY0 = (bin / binsX) * BIN_SIZE;
+    const int binX1 = std::min(binX0 + BIN_SIZE, width) - 1;
+    const int binY1 = std::min(binY0 + BIN_SIZE, height) - 1;
+    const int half = SUBPIXEL_SCALE / 2;
+    long long pixels = 0;
+    
+    // Binners took consecutive index ranges, so visiting them in order keeps
+    // the submission order of the triangles
+    for (const BinnerScratch& binner : binners) {
+        for (int index : binner.bins[bin]) {
+            const SetupTriangle& tri = binner.triangles[index];
+            const ShadeVertex* v[3];
+            for (int i = 0; i < 3; i++) {
+                v[i] = tri.vertex[i] >= 0 ? &shadeVertices[tri.vertex[i]]
+                                          : &binner.clipVertices[-tri.vertex[i] - 1];
+            }
+            
+            // Edge i runs between the two vertices opposite vertex i, so its
+            // edge function is vertex i's barycentric weight times the area.
+            // Pixels exactly on an edge belong to the triangle only for top
+            // and left edges, so shared edges are drawn once.
+            long long stepX[3], stepY[3], bias[3], e0[3];
+            const int x0 = std::max(tri.minX, binX0), x1 = std::min(tri.maxX, binX1);
+            const int y0 = std::max(tri.minY, binY0), y1 = std::min(tri.maxY, binY1);
+            if (x0 > x1 || y0 > y1) continue;
+            
+            for (int i = 0; i < 3; i++) {
+                int a = (i + 1) % 3, b = (i + 2) % 3;
+                long long dx = tri.x[b] - tri.x[a];
+                long long dy = tri.y[b] - tri.y[a];
+                bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+                bias[i] = topLeft ? 0 : -1;
+                stepX[i] = -dy * SUBPIXEL_SCALE;
+                stepY[i] = dx * SUBPIXEL_SCALE;
+                
+                // Value at the center of pixel (x0, y0)
+                long long cx = static_cast<long long>(x0) * SUBPIXEL_SCALE + half;
+                long long cy = static_cast<long long>(y0) * SUBPIXEL_SCALE + half;
+                e0[i] = dx * (cy - tri.y[a]) - dy * (cx - tri.x[a]) + bias[i];
+            }
+            const float invArea = 1.0f / static_cast<float>(tri.area);
+            
+            // Walk the 8x8 blocks of the screen grid that the box overlaps
+            for (int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+                for (int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+                    float& blockMax = blockMaxDepth[by * blocksX + bx];
+                    
+                    // Hierarchical z: the triangle's nearest point is behind
+                    // everything already drawn in the block
+                    if (tri.zmin >= blockMax) {
+                        blocksRejected++;
+                        continue;
+                    }
+                    
+                    const int px0 = std::max(bx * BLOCK_SIZE, x0), px1 = std::min(bx * BLOCK_SIZE + BLOCK_SIZE - 1, x1);
+                    const int py0 = std::max(by * BLOCK_SIZE, y0), py1 = std::min(by * BLOCK_SIZE + BLOCK_SIZE - 1, y1);
+                    
+                    // Edge values at the block's first pixel; skip the block if
+                    // all four corner pixels are outside one edge
+                    long long rowE[3];
+                    bool outside = false;
+                    for (int i = 0; i < 3 && !outside; i++) {
+                        rowE[i] = e0[i] + stepX[i] * (px0 - x0) + stepY[i] * (py0 - y0);
+                        long long ex = stepX[i] * (px1 - px0), ey = stepY[i] * (py1 - py0);
+                        long long cornerMax = rowE[i] + std::max(ex, 0LL) + std::max(ey, 0LL);
+                        outside = cornerMax < 0;
+                    }
+                    if (outside) continue;
+                    
+                    bool written = false;
+                    for (int py = py0; py <= py1; py++) {
+                        long long e[3] = { rowE[0], rowE[1], rowE[2] };
+                        float* depth = &depthBuffer[static_cast<size_t>(py) * width];
+                        
+                        for (int px = px0; px <= px1; px++) {
+                            if ((e[0] | e[1] | e[2]) >= 0) {
+                                float l0 = static_cast<float>(e[0]) * invArea;
+                                float l1 = static_cast<float>(e[1]) * invArea;
+                                float l2 = 1.0f - l0 - l1;
+                                float z = l0 * tri.z[0] + l1 * tri.z[1] + l2 * tri.z[2];
+                                
+                                if (z < depth[px]) {
+                                    depth[px] = z;
+                                    written = true;
+                                    pixels++;
+                                    
+                                    // Perspective-correct attribute weights
+                                    float w0 = l0 * tri.invW[0], w1 = l1 * tri.invW[1], w2 = l2 * tri.invW[2];
+                                    float norm = 1.0f / (w0 + w1 + w2);
+                                    w0 *= norm; w1 *= norm; w2 *= norm;
+                                    
+                                    glm::vec3 color = v[0]->color * w0 + v[1]->color * w1 + v[2]->color * w2;
+                                    if (shadingMode == SHADE_PHONG) {
+                                        glm::vec3 pos = v[0]->worldPos * w0 + v[1]->worldPos * w1 + v[2]->worldPos * w2;
+                                        glm::vec3 n = v[0]->normal * w0 + v[1]->normal * w1 + v[2]->normal * w2;
+                                        color = shade(pos, n, color, lighting);
+                                    }
+                                    
+                                    float* out = target.pixelPtr(px, py);
+                                    out[0] = color.r;
+                                    out[1] = color.g;
+                                    out[2] = color.b;
+                                }
+                            }
+                            e[0] += stepX[0];
+                            e[1] += stepX[1];
+                            e[2] += stepX[2];
+                        }
+                        rowE[0] += stepY[0];
+                        rowE[1] += stepY[1];
+                        rowE[2] += stepY[2];
+                    }
+                    
+                    // Refresh the block's farthest depth after drawing into it
+                    if (written) {
+                        float farthest = 0.0f;
+                        int bx1 = std::min(bx * BLOCK_SIZE + BLOCK_SIZE, width);
+                        int by1 = std::min(by * BLOCK_SIZE + BLOCK_SIZE, height);
+                        for (int py = by * BLOCK_SIZE; py < by1; py++) {
+                            const float* depth = &depthBuffer[static_cast<size_t>(py) * width];
+                            for (int px = bx * BLOCK_SIZE; px < bx1; px++) {
+                                farthest = std::max(farthest, depth[px]);
+                            }
+                        }
+                        blockMax = farthest;
+                    }
+                }
+            }
+        }
+    }
+    
+    return pixels;
+}
+
+void SoftwarePipeline::draw(RasterFramebuffer& target, const SoftVertexInput& input,
+                            const unsigned int* indices, int indexCount,
+                            const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                            const SoftLighting& lighting) {
+    auto start = std::chrono::steady_clock::now();
+    
+    if (target.getWidth() != width || target.getHeight() != height) {
+        clear(target, glm::vec3(0.0f));
+    }
+    
+    stats = SoftRenderStats();
+    const int numTriangles = indexCount / 3;
+    stats.triangles = numTriangles;
+    const int numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    
+    // 1. Vertex transform, in contiguous chunks per thread
+    const glm::mat4 viewProjection = projection * view;
+    const glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+    clipPositions.resize(input.count);
+    shadeVertices.resize(input.count);
+    runThreads(numThreads, [&](int thread) {
+        int begin = static_cast<int>(static_cast<long long>(input.count) * thread / numThreads);
+        int end = static_cast<int>(static_cast<long long>(input.count) * (thread + 1) / numThreads);
+        transformVertices(input, begin, end, model, normalMatrix, viewProjection, lighting);
+    });
+    
+    // 2. Setup and binning; binner t takes the t-th range of triangles.
+    //    All containers keep their capacity from the previous frame.
+    if (static_cast<int>(binners.size()) != numThreads) {
+        binners.resize(numThreads);
+    }
+    for (BinnerScratch& binner : binners) {
+        binner.triangles.clear();
+        binner.clipVertices.clear();
+        binner.bins.resize(binsX * binsY);
+        for (auto& list : binner.bins) list.clear();
+    }
+    runThreads(numThreads, [&](int thread) {
+        int begin = static_cast<int>(static_cast<long long>(numTriangles) * thread / numThreads);
+        int end = static_cast<int>(static_cast<long long>(numTriangles) * (thread + 1) / numThreads);
+        setupTriangles(indices, begin, end, binners[thread]);
+    });
+    for (const BinnerScratch& binner : binners) {
+        stats.rasterized += static_cast<int>(binner.triangles.size());
+    }
+    
+    // 3. Rasterization; workers own one bin at a time, so the color, depth
+    //    and block buffers are written without locks
+    const int numBins = binsX * binsY;
+    std::atomic<int> nextBin(0);
+    std::atomic<long long> totalPixels(0), totalRejected(0);
+    runThreads(std::min(numThreads, std::max(numBins, 1)), [&](int) {
+        long long pixels = 0, rejected = 0;
+        for (int bin = nextBin++; bin < numBins; bin = nextBin++) {
+            pixels += rasterizeBin(target, bin, lighting, rejected);
+        }
+        totalPixels += pixels;
+        totalRejected += rejected;
+    });
+    
+    stats.pixelsShaded = totalPixels;
+    stats.blocksRejected = totalRejected;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,137 @@
+#ifndef SOFT_PIPELINE_H
+#define SOFT_PIPELINE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+#include "raster_core.h"
+
+// GL-free software 3D pipeline for indexed triangle meshes. It mirrors what
+// the OpenGL 3D view does with shaders/basic.*: vertices are transformed by
+// model, view and projection, triangles are clipped, back faces culled, and
+// the survivors are depth tested (GL_LESS) and lit with the same ambient +
+// diffuse + specular model.
+//
+// Frames run in three multithreaded stages:
+//   1. Vertex transform over chunks of the vertex array
+//   2. Triangle setup and binning over chunks of the index array: clipping,
+//      culling, fixed-point edge functions, and a list per 64x64 pixel bin
+//   3. Rasterization, one bin per worker at a time. Each triangle is walked
+//      in 8x8 pixel blocks with edge functions; blocks entirely outside an
+//      edge, or behind the farthest depth already in the block (the
+//      hierarchical z-buffer), are skipped without touching their pixels.
+
+// Where lighting is evaluated
+enum ShadingMode {
+    SHADE_GOURAUD,  // Per vertex, colors interpolated across the triangle
+    SHADE_PHONG     // Per pixel, like shaders/basic.frag
+};
+
+// Interleaved vertex attributes, described the way glVertexAttribPointer
+// does: a base pointer, a stride and an offset per attribute (all in bytes)
+struct SoftVertexInput {
+    const void* data = nullptr;
+    int count = 0;
+    size_t stride = 0;
+    size_t positionOffset = 0;
+    size_t normalOffset = 0;
+    size_t colorOffset = 0;
+};
+
+// Uniforms of shaders/basic.frag
+struct SoftLighting {
+    glm::vec3 lightPos = glm::vec3(5.0f, 5.0f, 5.0f);
+    glm::vec3 lightColor = glm::vec3(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+};
+
+// Counters for the most recent draw
+struct SoftRenderStats {
+    int triangles = 0;          // Triangles submitted
+    int rasterized = 0;         // Triangles (after clipping) that reached a bin
+    long long blocksRejected = 0; // 8x8 blocks skipped by the hierarchical z test
+    long long pixelsShaded = 0; // Pixels that passed the depth test
+    double milliseconds = 0.0;
+};
+
+class SoftwarePipeline {
+private:
+    // Attributes needed for shading, per vertex. With Gouraud shading color
+    // already holds the lit color.
+    struct ShadeVertex {
+        glm::vec3 worldPos;
+        glm::vec3 normal;
+        glm::vec3 color;
+    };
+
+    // A triangle ready for rasterization: fixed-point screen positions,
+    // depth and 1/w at the vertices, and where to find its attributes.
+    // Vertex indices >= 0 refer to the transformed mesh vertices, indices
+    // < 0 to vertex -(index + 1) made by the binning thread's clipper.
+    struct SetupTriangle {
+        int x[3], y[3];
+        float z[3];
+        float invW[3];
+        int vertex[3];
+        int minX, minY, maxX, maxY;   // Covered pixel range, clipped to the target
+        float zmin;
+        long long area;               // Twice the area in subpixel units squared
+    };
+
+    // Per binning thread: the triangles it set up, the vertices its clipper
+    // created, and a triangle list per bin
+    struct BinnerScratch {
+        std::vector<SetupTriangle> triangles;
+        std::vector<ShadeVertex> clipVertices;
+        std::vector<std::vector<int>> bins;
+    };
+
+    ShadingMode shadingMode;
+    SoftRenderStats stats;
+
+    // Depth buffer (window-space z in [0, 1]) and, per 8x8 block, the
+    // farthest depth stored anywhere in the block
+    int width, height;
+    int blocksX, blocksY;
+    std::vector<float> depthBuffer;
+    std::vector<float> blockMaxDepth;
+
+    // Transformed vertices: clip-space positions and shading attributes
+    std::vector<glm::vec4> clipPositions;
+    std::vector<ShadeVertex> shadeVertices;
+
+    // Bins of 64x64 pixels and the per-thread binning state
+    int binsX, binsY;
+    std::vector<BinnerScratch> binners;
+
+    void resizeTargets(int w, int h);
+
+    // Pipeline stages
+    void transformVertices(const SoftVertexInput& input, int begin, int end, const glm::mat4& model,
+                           const glm::mat3& normalMatrix, const glm::mat4& viewProjection,
+                           const SoftLighting& lighting);
+    void setupTriangles(const unsigned int* indices, int begin, int end, BinnerScratch& binner);
+    void emitTriangle(const glm::vec4* clip, const int* vertex, BinnerScratch& binner);
+    void clipTriangle(const int* vertex, int outcodeUnion, BinnerScratch& binner);
+    long long rasterizeBin(RasterFramebuffer& target, int bin, const SoftLighting& lighting,
+                           long long& blocksRejected);
+
+public:
+    SoftwarePipeline();
+
+    void setShadingMode(ShadingMode mode) { shadingMode = mode; }
+    ShadingMode getShadingMode() const { return shadingMode; }
+    const SoftRenderStats& getStats() const { return stats; }
+
+    // Clear the color target and reset the depth buffer to the far plane
+    void clear(RasterFramebuffer& target, const glm::vec3& color);
+
+    // Draw an indexed triangle list into the target. The target must have
+    // been cleared by clear() at its current size.
+    void draw(RasterFramebuffer& target, const SoftVertexInput& input,
+              const unsigned int* indices, int indexCount,
+              const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+              const SoftLighting& lighting);
+};
+
+#endif // SOFT_PIPELINE_H
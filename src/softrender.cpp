@@ -0,0 +1,60 @@
+#include "softrender.h"
+#include "profiler.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <cstddef>
+
+// External variables from main.cpp
+extern FrameUniforms* frame_uniforms;
+
+SoftwareRenderer::SoftwareRenderer(int w, int h)
+    : width(w), height(h), display("SoftwareRenderer::render", w, h),
+      frameBuffer(w, h, true) { // Rows flipped for OpenGL
+}
+
+void SoftwareRenderer::resize(int w, int h) {
+    // Update dimensions
+    width = w;
+    height = h;
+    
+    // Resize the buffer
+    frameBuffer.resize(width, height);
+    
+    // Recreate framebuffer texture with new size
+    display.resize(width, height);
+}
+
+void SoftwareRenderer::render(const Mesh* mesh) {
+    PROFILE_SCOPE("SoftwareRenderer::render");
+    
+    // Same camera, projection and light as Mesh::render: the constants
+    // uploaded for this frame
+    const FrameConstants& frame = frame_uniforms->getConstants();
+    glm::vec3 viewPos = frame_uniforms->getViewPos();
+    
+    SoftLighting lighting;
+    lighting.lightPos = frame_uniforms->getLightPos();
+    lighting.lightColor = frame_uniforms->getLightColor();
+    lighting.viewPos = viewPos;
+    
+    // MeshVertex is read in place, like the GL vertex attributes
+    const std::vector<MeshVertex>& vertices = mesh->getVertices();
+    const std::vector<unsigned int>& indices = mesh->getIndices();
+    SoftVertexInput input;
+    input.data = vertices.data();
+    input.count = static_cast<int>(vertices.size());
+    input.stride = sizeof(MeshVertex);
+    input.positionOffset = offsetof(MeshVertex, position);
+    input.normalOffset = offsetof(MeshVertex, normal);
+    input.colorOffset = offsetof(MeshVertex, color);
+    
+    // Draw on the CPU over the same background as the GL view, with the
+    // level of detail Mesh::render would pick
+    const MeshLod& lod = mesh->getLod(mesh->selectLod(viewPos, (float)height));
+    pipeline.clear(frameBuffer, glm::vec3(0.2f, 0.2f, 0.2f));
+    pipeline.draw(frameBuffer, input, indices.data() + lod.indexOffset, static_cast<int>(lod.indexCount),
+                  mesh->getModelMatrix(), frame.view, frame.projection, lighting);
+    
+    // Upload and display the result; only this part runs on the GPU
+    display.present(frameBuffer.data());
+}
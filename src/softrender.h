@@ -0,0 +1,43 @@
+#ifndef SOFTRENDER_H
+#define SOFTRENDER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "canvas_display.h"
+#include "raster_core.h"
+#include "soft_pipeline.h"
+#include "mesh.h"
+
+// Draws the 3D view's mesh with the software pipeline instead of OpenGL,
+// then shows the result on a full-screen quad like the 2D views do
+class SoftwareRenderer {
+private:
+    // Canvas dimensions
+    int width, height;
+    
+    // Texture the CPU framebuffer is uploaded to, and how it is displayed
+    CanvasDisplay display;
+    
+    // Color target (rows flipped for OpenGL) and the pipeline drawing into it
+    RasterFramebuffer frameBuffer;
+    SoftwarePipeline pipeline;
+    
+public:
+    SoftwareRenderer(int w, int h);
+    
+    // Resize the renderer canvas
+    void resize(int w, int h);
+    
+    // Per-vertex or per-pixel lighting
+    void setShadingMode(ShadingMode mode) { pipeline.setShadingMode(mode); }
+    ShadingMode getShadingMode() const { return pipeline.getShadingMode(); }
+    
+    // Counters and timing of the last frame
+    const SoftRenderStats& getStats() const { return pipeline.getStats(); }
+    
+    // Draw the mesh with the same camera, projection and light as
+    // Mesh::render, on the CPU, and display it
+    void render(const Mesh* mesh);
+};
+
+#endif // SOFTRENDER_H
@@ -0,0 +1,117 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Compact GPU vertex layout: 16 bytes per vertex instead of the 36 bytes of
+// three float vec3s. Positions are 16-bit signed normalized values relative
+// to the mesh's bounding box, normals are octahedral-encoded into two 16-bit
+// values, and colors are 8 bits per channel. All three are read by the GPU
+// as normalized integer attributes, so the vertex shader only has to undo
+// the bounding box mapping and the octahedral encoding.
+struct PackedMeshVertex {
+    int16_t position[4];    // snorm16 in [-1, 1] across the bounding box; [3] pads to 8 bytes
+    int16_t normal[2];      // snorm16 octahedral-encoded unit normal
+    uint8_t color[4];       // unorm8 RGB; [3] pads to 4 bytes
+};
+
+// Maps positions in the bounding box to [-1, 1] on each axis:
+// position = center + halfExtent * quantized
+struct PositionQuantization {
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 halfExtent = glm::vec3(1.0f);
+};
+
+namespace VertexPacking {
+    // Float in [-1, 1] to snorm16, as OpenGL decodes it (value / 32767)
+    inline int16_t quantizeSnorm16(float v) {
+        v = std::min(std::max(v, -1.0f), 1.0f);
+        return static_cast<int16_t>(std::lround(v * 32767.0f));
+    }
+
+    inline float dequantizeSnorm16(int16_t v) {
+        return std::max(static_cast<float>(v) / 32767.0f, -1.0f);
+    }
+
+    // Float in [0, 1] to unorm8
+    inline uint8_t quantizeUnorm8(float v) {
+        v = std::min(std::max(v, 0.0f), 1.0f);
+        return static_cast<uint8_t>(std::lround(v * 255.0f));
+    }
+
+    // Project a unit vector onto the octahedron |x| + |y| + |z| = 1 and
+    // unfold the lower half over the upper one, giving a point in [-1, 1]^2
+    inline glm::vec2 octEncode(const glm::vec3& n) {
+        glm::vec3 p = n / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+        glm::vec2 e(p.x, p.y);
+        if (p.z < 0.0f) {
+            e = glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                          (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return e;
+    }
+
+    // Inverse of octEncode (the same decode is in shaders/basic_packed.vert)
+    inline glm::vec3 octDecode(const glm::vec2& e) {
+        glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+        float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+    // Bounding box mapping for a set of positions
+    template <typename Iterator>
+    PositionQuantization computePositionQuantization(Iterator begin, Iterator end) {
+        PositionQuantization q;
+        if (begin == end) {
+            return q;
+        }
+        glm::vec3 lo(begin->position), hi(begin->position);
+        for (Iterator it = begin; it != end; ++it) {
+            lo = glm::min(lo, it->position);
+            hi = glm::max(hi, it->position);
+        }
+        q.center = (lo + hi) * 0.5f;
+        // A flat axis still needs a non-zero extent to divide by
+        q.halfExtent = glm::max((hi - lo) * 0.5f, glm::vec3(1e-6f));
+        return q;
+    }
+
+    inline PackedMeshVertex packVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color,
+                                       const PositionQuantization& q) {
+        PackedMeshVertex packed;
+        glm::vec3 p = (position - q.center) / q.halfExtent;
+        packed.position[0] = quantizeSnorm16(p.x);
+        packed.position[1] = quantizeSnorm16(p.y);
+        packed.position[2] = quantizeSnorm16(p.z);
+        packed.position[3] = 0;
+
+        // Degenerate normals (no incident faces) encode as +z
+        float length = glm::length(normal);
+        glm::vec2 e = length > 0.0f ? octEncode(normal / length) : glm::vec2(0.0f);
+        packed.normal[0] = quantizeSnorm16(e.x);
+        packed.normal[1] = quantizeSnorm16(e.y);
+
+        packed.color[0] = quantizeUnorm8(color.r);
+        packed.color[1] = quantizeUnorm8(color.g);
+        packed.color[2] = quantizeUnorm8(color.b);
+        packed.color[3] = 255;
+        return packed;
+    }
+
+    inline glm::vec3 unpackPosition(const PackedMeshVertex& v, const PositionQuantization& q) {
+        return q.center + q.halfExtent * glm::vec3(dequantizeSnorm16(v.position[0]),
+                                                   dequantizeSnorm16(v.position[1]),
+                                                   dequantizeSnorm16(v.position[2]));
+    }
+
+    inline glm::vec3 unpackNormal(const PackedMeshVertex& v) {
+        return octDecode(glm::vec2(dequantizeSnorm16(v.normal[0]), dequantizeSnorm16(v.normal[1])));
+    }
+}
+
+#endif // VERTEX_PACKING_H